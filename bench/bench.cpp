@@ -0,0 +1,146 @@
+//Headless benchmark of ChordVault::process.
+//Prints the time per sample and the samples per second for every play mode, while recording and while playing, with 3
+//to 8 channels, at 48 and 96 kHz.
+//Only members that exist since the first version are touched, so the same file builds against older commits.
+//-DBENCH_SAMPLE_RATE=<Hz> runs a single sample rate instead.
+//-DBENCH_CONTROL_RATE=<samples> sets the control rate, for the versions that have one.
+//-DBENCH_CHANNELS_MIN and -DBENCH_CHANNELS_MAX change the channel counts, up to the CHANNEL_COUNT of the version.
+
+#include "ChordVault.cpp"
+#include <chrono>
+
+Plugin* pluginInstance;
+
+#ifdef BENCH_SAMPLE_RATE
+static const int SAMPLE_RATES [] = {BENCH_SAMPLE_RATE};
+#else
+static const int SAMPLE_RATES [] = {48000, 96000};
+#endif
+#define CLOCK_RATE 100 //A new step every 10 ms
+#define RECORD_STEPS 16
+#define BENCH_SAMPLES 480000
+#define BENCH_RUNS 7
+#ifndef BENCH_CHANNELS_MIN
+#define BENCH_CHANNELS_MIN 3
+#endif
+#ifndef BENCH_CHANNELS_MAX
+#define BENCH_CHANNELS_MAX 8
+#endif
+
+static float sink = 0.f;
+
+//Drives the inputs of one ChordVault sample by sample
+struct BenchPatch {
+	ChordVault vault;
+	Module::ProcessArgs args;
+	int clockPeriod;
+	int64_t frame = 0;
+
+	BenchPatch(int sampleRate){
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+		args.frame = 0;
+		clockPeriod = sampleRate / CLOCK_RATE;
+		vault.inputs[ChordVault::CLOCK_INPUT].channels = 1;
+		vault.inputs[ChordVault::STEP_CV_INPUT].channels = 1;
+		vault.inputs[ChordVault::GATE_IN_INPUT].channels = BENCH_CHANNELS_MAX;
+		vault.inputs[ChordVault::CV_IN_INPUT].channels = BENCH_CHANNELS_MAX;
+		vault.outputs[ChordVault::GATE_OUT_OUTPUT].channels = 1;
+		vault.outputs[ChordVault::CV_OUT_OUTPUT].channels = 1;
+		vault.params[ChordVault::LENGTH_KNOB_PARAM].setValue(RECORD_STEPS);
+	}
+
+	//One step per clock. While recording the gates follow the clock so every clock records a chord.
+	//The inputs only change on the clock edges, so the time spent here stays small next to process().
+	void step(bool gates){
+		int phase = frame % clockPeriod;
+		if(phase == 0 || phase == clockPeriod / 2){
+			int64_t clock = frame / clockPeriod;
+			bool clockHigh = phase == 0;
+			vault.inputs[ChordVault::CLOCK_INPUT].setVoltage(clockHigh ? 10.f : 0.f);
+			vault.inputs[ChordVault::STEP_CV_INPUT].setVoltage((clock * 7 % RECORD_STEPS) * 5.f / RECORD_STEPS);
+			for(int ci = 0; ci < BENCH_CHANNELS_MAX; ci++){
+				bool gate = gates && clockHigh && (clock + ci) % 4 != 0;
+				vault.inputs[ChordVault::GATE_IN_INPUT].setVoltage(gate ? 10.f : 0.f, ci);
+				vault.inputs[ChordVault::CV_IN_INPUT].setVoltage((clock * 5 + ci * 4) % 24 / 12.f - 1.f, ci);
+			}
+		}
+		args.frame = frame++;
+		vault.process(args);
+		sink += vault.outputs[ChordVault::CV_OUT_OUTPUT].getVoltage(0) + vault.outputs[ChordVault::GATE_OUT_OUTPUT].getVoltage(0);
+	}
+
+	//Long enough for the control rate of any version to see the button
+	void pressRecordPlay(){
+		vault.params[ChordVault::RECORD_PLAY_BTN_PARAM].setValue(1.f);
+		for(int i = 0; i < 256; i++) step(false);
+		vault.params[ChordVault::RECORD_PLAY_BTN_PARAM].setValue(0.f);
+		for(int i = 0; i < 256; i++) step(false);
+	}
+};
+
+//Nanoseconds per sample, the best of a few runs
+static double runBench(int sampleRate, int mode, bool recording, int channels){
+	double best = INFINITY;
+	for(int ri = 0; ri < BENCH_RUNS; ri++){
+		BenchPatch* patch = new BenchPatch(sampleRate);
+		patch->vault.channels = channels;
+		patch->vault.updateActiveChannels();
+		patch->vault.playMode = (PlayMode)mode;
+#ifdef BENCH_CONTROL_RATE
+		patch->vault.setControlRate(BENCH_CONTROL_RATE);
+#endif
+		if(!recording){
+			for(int i = 0; i < RECORD_STEPS * patch->clockPeriod; i++) patch->step(true);
+			patch->pressRecordPlay();
+		}
+		//One second of warm up
+		for(int i = 0; i < sampleRate; i++) patch->step(recording);
+
+		auto start = std::chrono::steady_clock::now();
+		for(int i = 0; i < BENCH_SAMPLES; i++) patch->step(recording);
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / BENCH_SAMPLES);
+		delete patch;
+	}
+	return best;
+}
+
+#define BENCH_CHANNELS (BENCH_CHANNELS_MAX - BENCH_CHANNELS_MIN + 1)
+
+//One row of ns/sample per channel count, followed by the samples per second at the mean of the row
+static void printRow(const char* mode, const char* state, const double* ns){
+	printf("%-12s %-7s", mode, state);
+	double mean = 0.0;
+	for(int i = 0; i < BENCH_CHANNELS; i++){
+		printf(" %8.2f", ns[i]);
+		mean += ns[i] / BENCH_CHANNELS;
+	}
+	printf(" %11.2fM\n", 1e3 / mean);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv){
+	for(int sampleRate : SAMPLE_RATES){
+		printf("# %d Hz, clock every %d samples, %d samples per run, best of %d runs\n", sampleRate, sampleRate / CLOCK_RATE, BENCH_SAMPLES, BENCH_RUNS);
+		printf("%-12s %-7s", "mode", "state");
+		for(int channels = BENCH_CHANNELS_MIN; channels <= BENCH_CHANNELS_MAX; channels++) printf(" %6dch", channels);
+		printf("   samples/s\n");
+
+		for(int recording = 1; recording >= 0; recording--){
+			const char* state = recording ? "record" : "play";
+			double mean [BENCH_CHANNELS] = {};
+			for(int mode = 0; mode < PlayMode_MAX; mode++){
+				double ns [BENCH_CHANNELS];
+				for(int i = 0; i < BENCH_CHANNELS; i++){
+					ns[i] = runBench(sampleRate, mode, recording, BENCH_CHANNELS_MIN + i);
+					mean[i] += ns[i] / PlayMode_MAX;
+				}
+				printRow(PLAY_MODE_NAMES[mode].c_str(), state, ns);
+			}
+			printRow("mean", state, mean);
+		}
+		printf("\n");
+	}
+	return sink == 12345.f;
+}
@@ -0,0 +1,768 @@
+#pragma once
+
+//Headless stand-in for the parts of the Rack SDK that the plugin sources use, so a ChordVault can be built and
+//driven without Rack. The engine side (Module, Port, Param, Light, expanders, simd, dsp, random) behaves like Rack 2.
+//The UI side is only declared with empty bodies so the widget code compiles, it is never called.
+//Patch storage (jansson) is not available and aborts when used.
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <ctime>
+#include <pmmintrin.h>
+
+#define DEBUG(format, ...) fprintf(stderr, "[debug] " format "\n", ##__VA_ARGS__)
+#define INFO(format, ...) fprintf(stderr, "[info] " format "\n", ##__VA_ARGS__)
+#define WARN(format, ...) fprintf(stderr, "[warn] " format "\n", ##__VA_ARGS__)
+
+inline void headlessUnavailable(const char* name){
+	fprintf(stderr, "%s is not available headless\n", name);
+	abort();
+}
+
+//jansson
+typedef struct json_t json_t;
+typedef long long json_int_t;
+inline json_t* json_object(){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_array(){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_real(double){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_integer(json_int_t){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_string(const char*){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_true(){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_false(){ headlessUnavailable("json"); return NULL; }
+inline json_t* json_null(){ headlessUnavailable("json"); return NULL; }
+inline int json_object_set_new(json_t*, const char*, json_t*){ headlessUnavailable("json"); return -1; }
+inline json_t* json_object_get(const json_t*, const char*){ headlessUnavailable("json"); return NULL; }
+inline int json_array_append_new(json_t*, json_t*){ headlessUnavailable("json"); return -1; }
+inline int json_array_insert_new(json_t*, size_t, json_t*){ headlessUnavailable("json"); return -1; }
+inline json_t* json_array_get(const json_t*, size_t){ headlessUnavailable("json"); return NULL; }
+inline size_t json_array_size(const json_t*){ headlessUnavailable("json"); return 0; }
+inline double json_real_value(const json_t*){ headlessUnavailable("json"); return 0; }
+inline json_int_t json_integer_value(const json_t*){ headlessUnavailable("json"); return 0; }
+inline double json_number_value(const json_t*){ headlessUnavailable("json"); return 0; }
+inline const char* json_string_value(const json_t*){ headlessUnavailable("json"); return NULL; }
+inline bool json_is_true(const json_t*){ headlessUnavailable("json"); return false; }
+inline bool json_is_null(const json_t*){ headlessUnavailable("json"); return false; }
+inline void json_decref(json_t*){ headlessUnavailable("json"); }
+inline json_t* json_load_file(const char*, size_t, void*){ headlessUnavailable("json"); return NULL; }
+#define json_array_foreach(array, index, value) \
+	for(index = 0; index < json_array_size(array) && (value = json_array_get(array, index)); index++)
+
+//nanovg
+struct NVGcontext;
+struct NVGcolor {
+	float r, g, b, a;
+};
+inline NVGcolor nvgRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a){
+	NVGcolor color = {r / 255.f, g / 255.f, b / 255.f, a / 255.f};
+	return color;
+}
+inline NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b){
+	return nvgRGBA(r, g, b, 255);
+}
+enum {
+	NVG_ALIGN_LEFT = 1,
+	NVG_ALIGN_CENTER = 2,
+	NVG_ALIGN_RIGHT = 4,
+	NVG_ALIGN_TOP = 8,
+	NVG_ALIGN_MIDDLE = 16,
+	NVG_ALIGN_BOTTOM = 32,
+	NVG_CCW = 1,
+	NVG_CW = 2,
+};
+inline void nvgBeginPath(NVGcontext*){}
+inline void nvgRect(NVGcontext*, float, float, float, float){}
+inline void nvgArc(NVGcontext*, float, float, float, float, float, int){}
+inline void nvgFill(NVGcontext*){}
+inline void nvgFillColor(NVGcontext*, NVGcolor){}
+inline void nvgStroke(NVGcontext*){}
+inline void nvgStrokeColor(NVGcontext*, NVGcolor){}
+inline void nvgStrokeWidth(NVGcontext*, float){}
+inline void nvgFontFaceId(NVGcontext*, int){}
+inline void nvgFontSize(NVGcontext*, float){}
+inline void nvgTextLetterSpacing(NVGcontext*, float){}
+inline void nvgTextAlign(NVGcontext*, int){}
+inline float nvgText(NVGcontext*, float, float, const char*, const char*){ return 0.f; }
+
+namespace rack {
+
+namespace math {
+
+template <typename T>
+T clamp(T x, T a, T b){
+	return std::max(std::min(x, b), a);
+}
+
+struct Vec {
+	float x = 0.f;
+	float y = 0.f;
+	Vec(){}
+	Vec(float x, float y) : x(x), y(y) {}
+	Vec plus(Vec b) const { return Vec(x + b.x, y + b.y); }
+	Vec minus(Vec b) const { return Vec(x - b.x, y - b.y); }
+	Vec mult(float s) const { return Vec(x * s, y * s); }
+	Vec div(float s) const { return Vec(x / s, y / s); }
+	bool equals(Vec b) const { return x == b.x && y == b.y; }
+};
+
+struct Rect {
+	Vec pos;
+	Vec size;
+	Vec getCenter() const { return pos.plus(size.mult(0.5f)); }
+};
+
+} //namespace math
+using namespace math;
+
+namespace simd {
+
+//Same layout and unaligned loads and stores as Rack's float_4
+struct float_4 {
+	__m128 v;
+	float_4(){}
+	float_4(__m128 v) : v(v) {}
+	float_4(float x) : v(_mm_set1_ps(x)) {}
+	float_4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+	static float_4 zero(){ return float_4(_mm_setzero_ps()); }
+	static float_4 load(const float* x){ return float_4(_mm_loadu_ps(x)); }
+	void store(float* x){ _mm_storeu_ps(x, v); }
+	float& operator[](int i){ return ((float*)&v)[i]; }
+	const float& operator[](int i) const { return ((const float*)&v)[i]; }
+};
+
+inline float_4 operator+(float_4 a, float_4 b){ return _mm_add_ps(a.v, b.v); }
+inline float_4 operator-(float_4 a, float_4 b){ return _mm_sub_ps(a.v, b.v); }
+inline float_4 operator-(float_4 a){ return _mm_sub_ps(_mm_setzero_ps(), a.v); }
+inline float_4 operator*(float_4 a, float_4 b){ return _mm_mul_ps(a.v, b.v); }
+inline float_4 operator/(float_4 a, float_4 b){ return _mm_div_ps(a.v, b.v); }
+inline float_4 operator&(float_4 a, float_4 b){ return _mm_and_ps(a.v, b.v); }
+inline float_4 operator|(float_4 a, float_4 b){ return _mm_or_ps(a.v, b.v); }
+inline float_4 operator==(float_4 a, float_4 b){ return _mm_cmpeq_ps(a.v, b.v); }
+inline float_4 operator!=(float_4 a, float_4 b){ return _mm_cmpneq_ps(a.v, b.v); }
+inline float_4 operator<(float_4 a, float_4 b){ return _mm_cmplt_ps(a.v, b.v); }
+inline float_4 operator<=(float_4 a, float_4 b){ return _mm_cmple_ps(a.v, b.v); }
+inline float_4 operator>(float_4 a, float_4 b){ return _mm_cmpgt_ps(a.v, b.v); }
+inline float_4 operator>=(float_4 a, float_4 b){ return _mm_cmpge_ps(a.v, b.v); }
+inline float_4& operator+=(float_4& a, float_4 b){ return a = a + b; }
+inline float_4& operator-=(float_4& a, float_4 b){ return a = a - b; }
+inline float_4& operator*=(float_4& a, float_4 b){ return a = a * b; }
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b){ return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline float_4 fmax(float_4 a, float_4 b){ return _mm_max_ps(a.v, b.v); }
+inline float_4 fmin(float_4 a, float_4 b){ return _mm_min_ps(a.v, b.v); }
+inline float_4 clamp(float_4 x, float_4 a, float_4 b){ return fmin(fmax(x, a), b); }
+inline float_4 fabs(float_4 a){ return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline int movemask(float_4 a){ return _mm_movemask_ps(a.v); }
+
+} //namespace simd
+
+namespace dsp {
+
+static const float FREQ_C4 = 261.6256f;
+
+struct ClockDivider {
+	uint32_t clock = 0;
+	uint32_t division = 1;
+	void reset(){ clock = 0; }
+	void setDivision(uint32_t division){ this->division = division; }
+	uint32_t getDivision(){ return division; }
+	uint32_t getClock(){ return clock; }
+	bool process(){
+		clock++;
+		if(clock >= division){
+			clock = 0;
+			return true;
+		}
+		return false;
+	}
+};
+
+//Lock-free single producer, single consumer queue
+template <typename T, size_t S>
+struct RingBuffer {
+	std::atomic<size_t> start{0};
+	std::atomic<size_t> end{0};
+	T data[S];
+	void push(T t){
+		data[end % S] = t;
+		end++;
+	}
+	T shift(){
+		T t = data[start % S];
+		start++;
+		return t;
+	}
+	void clear(){ start = end.load(); }
+	bool empty() const { return start >= end; }
+	bool full() const { return end - start >= S; }
+	size_t size() const { return end - start; }
+};
+
+} //namespace dsp
+
+namespace random {
+
+struct Xoroshiro128Plus {
+	uint64_t state[2] = {};
+
+	void seed(uint64_t s0, uint64_t s1){
+		state[0] = s0;
+		state[1] = s1;
+		//A bad seed gives a bad first result, so skip it
+		operator()();
+	}
+
+	static uint64_t rotl(uint64_t x, int k){
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t operator()(){
+		uint64_t s0 = state[0];
+		uint64_t s1 = state[1];
+		uint64_t result = s0 + s1;
+		s1 ^= s0;
+		state[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+		state[1] = rotl(s1, 36);
+		return result;
+	}
+};
+
+//Global generator, Rack has one per thread
+inline Xoroshiro128Plus& local(){
+	static Xoroshiro128Plus rng;
+	return rng;
+}
+inline uint64_t u64(){ return local()(); }
+inline uint32_t u32(){ return local()() >> 32; }
+inline float uniform(){ return (u32() >> 8) * 5.96046448e-08f; }
+
+} //namespace random
+
+namespace string {
+
+inline std::string f(const char* format, ...){
+	va_list args;
+	va_start(args, format);
+	char buffer[1024];
+	vsnprintf(buffer, sizeof buffer, format, args);
+	va_end(args);
+	return buffer;
+}
+inline std::string toBase64(const uint8_t*, size_t){ headlessUnavailable("string::toBase64"); return ""; }
+inline std::vector<uint8_t> fromBase64(const std::string&){ headlessUnavailable("string::fromBase64"); return {}; }
+
+} //namespace string
+
+namespace system {
+
+inline std::vector<std::string> getEntries(const std::string&, int = 0){ headlessUnavailable("system::getEntries"); return {}; }
+inline bool isDirectory(const std::string&){ headlessUnavailable("system::isDirectory"); return false; }
+inline std::string getFilename(const std::string& path){ return path; }
+inline std::string getStem(const std::string& path){ return path; }
+inline std::string getExtension(const std::string&){ return ""; }
+inline std::vector<uint8_t> readFile(const std::string&){ headlessUnavailable("system::readFile"); return {}; }
+inline void writeFile(const std::string&, const std::vector<uint8_t>&){ headlessUnavailable("system::writeFile"); }
+
+} //namespace system
+
+namespace plugin {
+
+struct Model;
+
+struct Plugin {
+	void addModel(Model*){}
+};
+
+} //namespace plugin
+using plugin::Plugin;
+
+namespace asset {
+
+inline std::string plugin(Plugin*, const std::string& path){ return path; }
+inline std::string system(const std::string& path){ return path; }
+inline std::string user(const std::string& path){ return path; }
+
+} //namespace asset
+
+namespace window {
+
+struct Font {
+	int handle = -1;
+};
+
+struct Svg {
+	static std::shared_ptr<Svg> load(const std::string&){ return std::make_shared<Svg>(); }
+};
+
+struct Window {
+	NVGcontext* vg = NULL;
+	std::shared_ptr<Font> loadFont(const std::string&){ return std::make_shared<Font>(); }
+};
+
+} //namespace window
+using window::Font;
+using window::Svg;
+
+namespace event {
+struct Change {};
+}
+
+namespace engine {
+
+struct Module;
+
+struct ParamQuantity {
+	Module* module = NULL;
+	int paramId = 0;
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	float defaultValue = 0.f;
+	std::string name;
+	std::string unit;
+	float displayBase = 0.f;
+	float displayMultiplier = 1.f;
+	float displayOffset = 0.f;
+	bool randomizeEnabled = true;
+	bool snapEnabled = false;
+
+	virtual ~ParamQuantity(){}
+	virtual float getValue();
+	virtual void setValue(float value);
+	virtual float getMinValue(){ return minValue; }
+	virtual float getMaxValue(){ return maxValue; }
+	virtual std::string getLabel(){ return name; }
+	virtual std::string getUnit(){ return unit; }
+	virtual std::string getDisplayValueString(){ return string::f("%g", getValue()); }
+	virtual std::string getString(){ return getLabel() + ": " + getDisplayValueString() + getUnit(); }
+};
+
+struct SwitchQuantity : ParamQuantity {
+	std::vector<std::string> labels;
+};
+
+struct Param {
+	float value = 0.f;
+	float getValue(){ return value; }
+	void setValue(float value){ this->value = value; }
+};
+
+static const int PORT_MAX_CHANNELS = 16;
+
+//channels is 0 while no cable is connected. The bench connects a cable by setting it to 1 or more.
+struct Port {
+	float voltages[PORT_MAX_CHANNELS] = {};
+	uint8_t channels = 0;
+
+	float getVoltage(int c = 0){ return voltages[c]; }
+	void setVoltage(float voltage, int c = 0){ voltages[c] = voltage; }
+	float getNormalVoltage(float normalVoltage, int c = 0){ return isConnected() ? voltages[c] : normalVoltage; }
+	float getPolyVoltage(int c){ return isMonophonic() ? voltages[0] : voltages[c]; }
+	template <typename T>
+	T getVoltageSimd(int c){ return T::load(&voltages[c]); }
+	template <typename T>
+	void setVoltageSimd(T voltage, int c){ voltage.store(&voltages[c]); }
+
+	//Like Rack, a disconnected port stays at 0 channels and a connected one at 1 or more
+	void setChannels(int channels){
+		if(this->channels == 0) return;
+		for(int c = channels; c < this->channels; c++) voltages[c] = 0.f;
+		if(channels == 0) channels = 1;
+		this->channels = channels;
+	}
+	int getChannels(){ return channels; }
+	bool isConnected(){ return channels > 0; }
+	bool isMonophonic(){ return channels == 1; }
+	bool isPolyphonic(){ return channels > 1; }
+};
+
+struct Input : Port {};
+struct Output : Port {};
+
+struct Light {
+	float value = 0.f;
+	void setBrightness(float brightness){ value = brightness; }
+	float getBrightness(){ return value; }
+	void setBrightnessSmooth(float brightness, float){ value = brightness; }
+};
+
+struct PortInfo {
+	std::string name;
+};
+
+struct LightInfo {
+	std::string name;
+};
+
+struct Module {
+	//Messages are written to producerMessage. The bench swaps producer and consumer after every sample when a flip was
+	//requested, like the Rack engine does.
+	struct Expander {
+		Module* module = NULL;
+		void* producerMessage = NULL;
+		void* consumerMessage = NULL;
+		bool messageFlipRequested = false;
+		void requestMessageFlip(){ messageFlipRequested = true; }
+	};
+
+	struct ProcessArgs {
+		float sampleRate;
+		float sampleTime;
+		int64_t frame;
+	};
+
+	struct ResetEvent {};
+	struct RandomizeEvent {};
+	struct ExpanderChangeEvent {
+		uint8_t side;
+	};
+
+	int64_t id = -1;
+	plugin::Model* model = NULL;
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+	std::vector<ParamQuantity*> paramQuantities;
+	std::vector<PortInfo> inputInfos;
+	std::vector<PortInfo> outputInfos;
+	std::vector<LightInfo> lightInfos;
+	Expander leftExpander;
+	Expander rightExpander;
+
+	virtual ~Module(){
+		for(ParamQuantity* quantity : paramQuantities) delete quantity;
+	}
+
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0){
+		params.resize(numParams);
+		paramQuantities.resize(numParams, NULL);
+		inputs.resize(numInputs);
+		inputInfos.resize(numInputs);
+		outputs.resize(numOutputs);
+		outputInfos.resize(numOutputs);
+		lights.resize(numLights);
+		lightInfos.resize(numLights);
+	}
+
+	template <class TParamQuantity = ParamQuantity>
+	TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f){
+		delete paramQuantities[paramId];
+		TParamQuantity* quantity = new TParamQuantity;
+		quantity->module = this;
+		quantity->paramId = paramId;
+		quantity->minValue = minValue;
+		quantity->maxValue = maxValue;
+		quantity->defaultValue = defaultValue;
+		quantity->name = name;
+		quantity->unit = unit;
+		quantity->displayBase = displayBase;
+		quantity->displayMultiplier = displayMultiplier;
+		quantity->displayOffset = displayOffset;
+		paramQuantities[paramId] = quantity;
+		params[paramId].value = defaultValue;
+		return quantity;
+	}
+
+	template <class TParamQuantity = ParamQuantity>
+	TParamQuantity* configButton(int paramId, std::string name = ""){
+		TParamQuantity* quantity = configParam<TParamQuantity>(paramId, 0.f, 1.f, 0.f, name);
+		quantity->randomizeEnabled = false;
+		return quantity;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> labels = {}){
+		TSwitchQuantity* quantity = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+		quantity->snapEnabled = true;
+		quantity->labels = labels;
+		return quantity;
+	}
+
+	PortInfo* configInput(int portId, std::string name = ""){
+		inputInfos[portId].name = name;
+		return &inputInfos[portId];
+	}
+
+	PortInfo* configOutput(int portId, std::string name = ""){
+		outputInfos[portId].name = name;
+		return &outputInfos[portId];
+	}
+
+	LightInfo* configLight(int lightId, std::string name = ""){
+		lightInfos[lightId].name = name;
+		return &lightInfos[lightId];
+	}
+
+	void configBypass(int, int){}
+
+	ParamQuantity* getParamQuantity(int paramId){
+		return paramQuantities[paramId];
+	}
+
+	virtual void process(const ProcessArgs& args){}
+	virtual void processBypass(const ProcessArgs& args){}
+	virtual json_t* dataToJson(){ return NULL; }
+	virtual void dataFromJson(json_t* rootJ){}
+	virtual void onReset(const ResetEvent& e){}
+	virtual void onRandomize(const RandomizeEvent& e){}
+	virtual void onExpanderChange(const ExpanderChangeEvent& e){}
+};
+
+inline float ParamQuantity::getValue(){
+	return module->params[paramId].getValue();
+}
+
+inline void ParamQuantity::setValue(float value){
+	module->params[paramId].setValue(math::clamp(value, getMinValue(), getMaxValue()));
+}
+
+} //namespace engine
+using engine::Module;
+using engine::ParamQuantity;
+using engine::SwitchQuantity;
+using engine::Param;
+using engine::Input;
+using engine::Output;
+using engine::Light;
+using engine::PORT_MAX_CHANNELS;
+
+namespace plugin {
+
+struct Model {
+	std::string slug;
+	virtual ~Model(){}
+	std::string getFactoryPresetDirectory(){ return "presets/" + slug; }
+	std::string getUserPresetDirectory(){ return "presets/" + slug; }
+	virtual engine::Module* createModule() = 0;
+};
+
+} //namespace plugin
+using plugin::Model;
+
+//Only the module side of a model is created, the widget type is never instantiated
+template <class TModule, class TModuleWidget>
+plugin::Model* createModel(std::string slug){
+	struct TModel : plugin::Model {
+		engine::Module* createModule() override {
+			engine::Module* module = new TModule;
+			module->model = this;
+			return module;
+		}
+	};
+	plugin::Model* model = new TModel;
+	model->slug = slug;
+	return model;
+}
+
+namespace widget {
+
+struct Widget {
+	math::Rect box;
+	Widget* parent = NULL;
+	std::list<Widget*> children;
+
+	struct DrawArgs {
+		NVGcontext* vg = NULL;
+		math::Rect clipBox;
+	};
+
+	virtual ~Widget(){}
+	virtual void step(){}
+	virtual void draw(const DrawArgs& args){}
+	virtual void drawLayer(const DrawArgs& args, int layer){}
+	void addChild(Widget* child){ children.push_back(child); }
+	void addChildAbove(Widget* child, Widget*){ children.push_back(child); }
+};
+
+struct TransparentWidget : Widget {};
+struct OpaqueWidget : Widget {};
+
+struct FramebufferWidget : Widget {
+	bool dirty = true;
+	void setDirty(bool dirty = true){ this->dirty = dirty; }
+};
+
+struct SvgWidget : Widget {
+	void setSvg(std::shared_ptr<window::Svg>){}
+};
+
+} //namespace widget
+using widget::Widget;
+using widget::TransparentWidget;
+using widget::OpaqueWidget;
+using widget::FramebufferWidget;
+
+namespace ui {
+
+struct Menu : widget::OpaqueWidget {};
+struct MenuEntry : widget::OpaqueWidget {};
+struct MenuLabel : MenuEntry {
+	std::string text;
+};
+struct MenuSeparator : MenuEntry {};
+struct MenuItem : MenuEntry {
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+};
+
+} //namespace ui
+using ui::Menu;
+using ui::MenuEntry;
+using ui::MenuLabel;
+using ui::MenuSeparator;
+using ui::MenuItem;
+
+namespace app {
+
+struct ParamWidget : widget::OpaqueWidget {
+	engine::Module* module = NULL;
+	int paramId = 0;
+	engine::ParamQuantity* getParamQuantity(){ return NULL; }
+	virtual void onChange(const event::Change& e){}
+};
+
+struct CircularShadow : widget::TransparentWidget {
+	float blurRadius = 0.f;
+};
+
+struct SvgKnob : ParamWidget {
+	float minAngle = -M_PI;
+	float maxAngle = M_PI;
+	bool snap = false;
+	bool smooth = true;
+	widget::FramebufferWidget* fb = new widget::FramebufferWidget;
+	CircularShadow* shadow = new CircularShadow;
+	void setSvg(std::shared_ptr<window::Svg>){}
+};
+
+struct RoundKnob : SvgKnob {
+	widget::SvgWidget* bg = new widget::SvgWidget;
+};
+
+struct SvgSwitch : ParamWidget {
+	bool momentary = false;
+	CircularShadow* shadow = new CircularShadow;
+	void addFrame(std::shared_ptr<window::Svg>){}
+};
+
+struct PortWidget : widget::OpaqueWidget {
+	engine::Module* module = NULL;
+	int portId = 0;
+};
+
+struct SvgPort : PortWidget {
+	CircularShadow* shadow = new CircularShadow;
+	void setSvg(std::shared_ptr<window::Svg>){}
+};
+
+struct ModuleLightWidget : widget::TransparentWidget {
+	void addBaseColor(NVGcolor){}
+};
+
+struct GrayModuleLightWidget : ModuleLightWidget {};
+
+struct ModuleWidget : widget::OpaqueWidget {
+	plugin::Model* model = NULL;
+	engine::Module* module = NULL;
+	void setModule(engine::Module* module){ this->module = module; }
+	engine::Module* getModule(){ return module; }
+	void loadAction(std::string){}
+	void setPanel(widget::Widget*){}
+	void addParam(ParamWidget* param){ addChild(param); }
+	void addInput(PortWidget* port){ addChild(port); }
+	void addOutput(PortWidget* port){ addChild(port); }
+	virtual void appendContextMenu(ui::Menu* menu){}
+};
+
+} //namespace app
+using namespace app;
+
+namespace componentlibrary {
+
+static const NVGcolor SCHEME_WHITE = nvgRGB(0xff, 0xff, 0xff);
+static const NVGcolor SCHEME_BLUE = nvgRGB(0x29, 0xb2, 0xef);
+static const NVGcolor SCHEME_RED = nvgRGB(0xed, 0x2c, 0x24);
+
+struct BlueLight : app::GrayModuleLightWidget {};
+struct RedLight : app::GrayModuleLightWidget {};
+template <typename TBase>
+struct SmallLight : TBase {};
+template <typename TBase>
+struct MediumLight : TBase {};
+struct ScrewSilver : widget::Widget {};
+
+} //namespace componentlibrary
+using namespace componentlibrary;
+
+static const float RACK_GRID_WIDTH = 15.f;
+static const float RACK_GRID_HEIGHT = 380.f;
+
+inline float mm2px(float mm){ return mm * 75.f / 25.4f; }
+inline math::Vec mm2px(math::Vec mm){ return mm.mult(75.f / 25.4f); }
+
+template <class TWidget>
+TWidget* createWidget(math::Vec pos){
+	TWidget* widget = new TWidget;
+	widget->box.pos = pos;
+	return widget;
+}
+template <class TWidget>
+TWidget* createWidgetCentered(math::Vec pos){ return createWidget<TWidget>(pos); }
+template <class TParamWidget>
+TParamWidget* createParam(math::Vec pos, engine::Module*, int){ return createWidget<TParamWidget>(pos); }
+template <class TParamWidget>
+TParamWidget* createParamCentered(math::Vec pos, engine::Module*, int){ return createWidget<TParamWidget>(pos); }
+template <class TPortWidget>
+TPortWidget* createInputCentered(math::Vec pos, engine::Module*, int){ return createWidget<TPortWidget>(pos); }
+template <class TPortWidget>
+TPortWidget* createOutputCentered(math::Vec pos, engine::Module*, int){ return createWidget<TPortWidget>(pos); }
+template <class TLightWidget>
+TLightWidget* createLightCentered(math::Vec pos, engine::Module*, int){ return createWidget<TLightWidget>(pos); }
+inline widget::Widget* createPanel(std::string){ return new widget::Widget; }
+
+inline ui::MenuLabel* createMenuLabel(std::string text){
+	ui::MenuLabel* label = new ui::MenuLabel;
+	label->text = text;
+	return label;
+}
+template <class TMenuItem = ui::MenuItem>
+TMenuItem* createMenuItem(std::string text, std::string rightText = "", std::function<void()> action = NULL, bool disabled = false, bool alwaysConsume = false){
+	TMenuItem* item = new TMenuItem;
+	item->text = text;
+	item->rightText = rightText;
+	item->disabled = disabled;
+	return item;
+}
+template <class TMenuItem = ui::MenuItem>
+ui::MenuItem* createSubmenuItem(std::string text, std::string rightText, std::function<void(ui::Menu* menu)> createMenu, bool disabled = false){
+	return createMenuItem<TMenuItem>(text, rightText, NULL, disabled);
+}
+
+#define CHECKMARK_STRING "✔"
+#define CHECKMARK(_cond) ((_cond) ? CHECKMARK_STRING : "")
+#define ENUMS(name, count) name, name##_LAST = name + (count) - 1
+
+struct Context {
+	window::Window* window = NULL;
+};
+inline Context* contextGet(){
+	static window::Window window;
+	static Context context;
+	context.window = &window;
+	return &context;
+}
+#define APP rack::contextGet()
+
+} //namespace rack
@@ -0,0 +1,286 @@
+//Headless replay of ChordVault scenarios.
+//Every scenario records a vault through the gate and V/oct inputs, switches to play and clocks it with resets, knob
+//moves and step CV. The outputs are written as a trace with one line per sample where anything changed.
+//  trace --write <dir>  writes one trace per scenario
+//  trace --check <dir>  compares every scenario sample by sample with the traces in <dir>
+//The scenarios read the controls every sample, so the control rate doesn't hide a change. With --default-rate first
+//they run at the default control rate instead and hold the buttons long enough for it.
+//Built with -DTRACE_BASELINE the scenarios are set up through the members of the first version, which is how the
+//golden traces are made. -DTRACE_CONTROL_RATE and -DTRACE_GLOBAL_RNG cover the versions in between, see `make series`.
+
+#include "ChordVault.cpp"
+#include <fstream>
+#include <sstream>
+
+#if defined(TRACE_BASELINE) && !defined(TRACE_GLOBAL_RNG)
+#define TRACE_GLOBAL_RNG
+#endif
+
+Plugin* pluginInstance;
+
+#define TRACE_SAMPLE_RATE 1000
+#define TRACE_CLOCK_PERIOD 20
+#define TRACE_RECORD_STEPS 16
+#define TRACE_PLAY_CLOCKS 90
+#define TRACE_SEED 0x5eed1234abcdULL
+#define TRACE_BUTTON_SAMPLES 2
+#define TRACE_DEFAULT_RATE_BUTTON_SAMPLES 64 //Twice the default control rate
+
+static bool defaultRate = false;
+
+enum StepCVPattern {
+	STEP_CV_NONE, //Disconnected
+	STEP_CV_VOLTS, //Jumps between 0 and 10.5V
+	STEP_CV_SEMITONES, //Jumps between semitones over two octaves, for the White Keys range
+};
+
+struct Scenario {
+	const char* name;
+	PlayMode playMode;
+	int channels;
+	CVOrder cvOrder;
+	CVRange cvRange;
+	bool skipPartialClock;
+	bool offset; //Turned on with the offset button before playing
+	int length; //Length knob
+	StepCVPattern stepCV;
+	bool lengthCV; //Length CV instead of the knob
+	bool knobMoves; //Turn the step knob while playing
+};
+
+static const Scenario SCENARIOS [] = {
+	//name                 mode       ch cvOrder    cvRange    skip   offset length stepCV             lengthCV knob
+	{"forward",            FORWARD,   5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"backward",           BACKWARD,  5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"random",             RANDOM,    5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"cv_0to5",            CV,        5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_VOLTS,     false, false},
+	{"cv_0to10",           CV,        5, Sorted,    ZeroTo10V, false, false, 16, STEP_CV_VOLTS,     false, false},
+	{"cv_whitekeys",       CV,        5, Sorted,    WhiteKeys, false, false, 16, STEP_CV_SEMITONES, false, false},
+	{"skip",               SKIP,      5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_VOLTS,     false, false},
+	{"skip_default",       SKIP,      5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"ping_pong",          PING_PONG, 5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"shuffle",            SHUFFLE,   5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, false},
+	{"glide",              GLIDE,     5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_VOLTS,     false, false},
+	{"condensed",          FORWARD,   5, Condensed, ZeroTo5V,  false, false, 16, STEP_CV_NONE,      false, false},
+	{"pristine",           FORWARD,   5, Pristine,  ZeroTo5V,  false, false, 16, STEP_CV_NONE,      false, false},
+	{"pristine_8ch",       BACKWARD,  8, Pristine,  ZeroTo5V,  false, false, 16, STEP_CV_NONE,      false, false},
+	{"sorted_3ch",         FORWARD,   3, Sorted,    ZeroTo5V,  false, false, 16, STEP_CV_NONE,      false, false},
+	{"skip_partial_clock", FORWARD,   5, Sorted,    ZeroTo5V,  true,  false, 12, STEP_CV_NONE,      false, false},
+	{"offset",             FORWARD,   5, Sorted,    ZeroTo5V,  false, true,  6,  STEP_CV_NONE,      false, true},
+	{"offset_step_cv",     PING_PONG, 5, Sorted,    ZeroTo5V,  false, true,  6,  STEP_CV_VOLTS,     false, true},
+	{"offset_cv",          CV,        5, Sorted,    ZeroTo5V,  false, true,  6,  STEP_CV_VOLTS,     false, true},
+	{"length_cv",          FORWARD,   5, Sorted,    ZeroTo5V,  false, false, 4,  STEP_CV_NONE,      true,  false},
+	{"knob_preview",       FORWARD,   5, Sorted,    ZeroTo5V,  false, false, 12, STEP_CV_NONE,      false, true},
+};
+
+//Small generator for the input patterns, independent of the module's random numbers
+struct PatternRng {
+	uint32_t state = 12345;
+	uint32_t next(){
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+};
+
+struct TracePatch {
+	const Scenario& scenario;
+	ChordVault vault;
+	Module::ProcessArgs args;
+	int64_t frame = 0;
+	PatternRng pattern;
+	std::ostringstream trace;
+	std::string lastLine;
+
+	TracePatch(const Scenario& scenario) : scenario(scenario) {
+		args.sampleRate = TRACE_SAMPLE_RATE;
+		args.sampleTime = 1.f / TRACE_SAMPLE_RATE;
+		args.frame = 0;
+		vault.inputs[ChordVault::CLOCK_INPUT].channels = 1;
+		vault.inputs[ChordVault::RESET_INPUT].channels = 1;
+		vault.inputs[ChordVault::GATE_IN_INPUT].channels = scenario.channels;
+		vault.inputs[ChordVault::CV_IN_INPUT].channels = scenario.channels;
+		if(scenario.stepCV != STEP_CV_NONE) vault.inputs[ChordVault::STEP_CV_INPUT].channels = 1;
+		vault.outputs[ChordVault::GATE_OUT_OUTPUT].channels = 1;
+		vault.outputs[ChordVault::CV_OUT_OUTPUT].channels = 1;
+		vault.params[ChordVault::LENGTH_KNOB_PARAM].setValue(scenario.length);
+
+#ifdef TRACE_BASELINE
+		vault.channels = scenario.channels;
+		vault.activeChannels = scenario.channels;
+		vault.playMode = scenario.playMode;
+		vault.cvOrder = scenario.cvOrder;
+		vault.cvRange = scenario.cvRange;
+		vault.skipPartialClock = scenario.skipPartialClock;
+#ifdef TRACE_CONTROL_RATE
+		if(!defaultRate) vault.setControlRate(1);
+#endif
+#else
+		if(!defaultRate) vault.pushCommand(ChordVault::SET_CONTROL_RATE_CMD, 1);
+		vault.pushCommand(ChordVault::SET_CHANNELS_CMD, scenario.channels);
+		vault.pushCommand(ChordVault::SET_PLAY_MODE_CMD, scenario.playMode);
+		vault.pushCommand(ChordVault::SET_CV_ORDER_CMD, scenario.cvOrder);
+		vault.pushCommand(ChordVault::SET_CV_RANGE_CMD, scenario.cvRange);
+		vault.pushCommand(ChordVault::SET_SKIP_PARTIAL_CLOCK_CMD, scenario.skipPartialClock);
+#endif
+		//The first versions draw from the global generator, seeded like the module's own generator
+		random::local().seed(TRACE_SEED, TRACE_SEED ^ 0x9e3779b97f4a7c15ULL);
+#ifndef TRACE_GLOBAL_RNG
+		vault.setSeed(TRACE_SEED);
+#endif
+	}
+
+	void step(){
+		args.frame = frame;
+		vault.process(args);
+
+		//Only the lines where an output changed are kept
+		std::string line = string::f("%d", vault.outputs[ChordVault::GATE_OUT_OUTPUT].getChannels());
+		for(int ci = 0; ci < vault.outputs[ChordVault::GATE_OUT_OUTPUT].getChannels(); ci++){
+			line += string::f(" %g", vault.outputs[ChordVault::GATE_OUT_OUTPUT].getVoltage(ci));
+		}
+		line += " |";
+		for(int ci = 0; ci < vault.outputs[ChordVault::CV_OUT_OUTPUT].getChannels(); ci++){
+			line += string::f(" %.9g", vault.outputs[ChordVault::CV_OUT_OUTPUT].getVoltage(ci));
+		}
+		if(line != lastLine){
+			trace << frame << " " << line << "\n";
+			lastLine = line;
+		}
+		frame++;
+	}
+
+	void pressButton(int paramId){
+		int samples = defaultRate ? TRACE_DEFAULT_RATE_BUTTON_SAMPLES : TRACE_BUTTON_SAMPLES;
+		vault.params[paramId].setValue(1.f);
+		for(int i = 0; i < samples; i++) step();
+		vault.params[paramId].setValue(0.f);
+		for(int i = 0; i < samples; i++) step();
+	}
+
+	//One chord per step, the gates of a chord rise on different samples and fall together
+	void record(){
+		Input& gates = vault.inputs[ChordVault::GATE_IN_INPUT];
+		Input& cvs = vault.inputs[ChordVault::CV_IN_INPUT];
+		for(int si = 0; si < TRACE_RECORD_STEPS; si++){
+			int mask = 0;
+			while(mask == 0) mask = pattern.next() & ((1 << scenario.channels) - 1);
+			for(int ci = 0; ci < scenario.channels; ci++){
+				cvs.setVoltage((int)(pattern.next() % 37) / 12.f - 1.f, ci);
+			}
+			for(int ci = 0; ci < scenario.channels; ci++){
+				if(mask & (1 << ci)){
+					gates.setVoltage(10.f, ci);
+					step();
+				}
+			}
+			for(int i = 0; i < 4; i++) step();
+			for(int ci = 0; ci < scenario.channels; ci++) gates.setVoltage(0.f, ci);
+			for(int i = 0; i < 4; i++) step();
+		}
+	}
+
+	float getStepCV(){
+		switch(scenario.stepCV){
+			case STEP_CV_VOLTS: return (int)(pattern.next() % 106) / 10.f;
+			case STEP_CV_SEMITONES: return (int)(pattern.next() % 25) / 12.f;
+			default: return 0.f;
+		}
+	}
+
+	void play(){
+		if(scenario.lengthCV){
+			vault.inputs[ChordVault::LENGTH_CV_INPUT].channels = 1;
+			vault.inputs[ChordVault::LENGTH_CV_INPUT].setVoltage(2.f);
+		}
+		for(int i = 0; i < 7; i++) step(); //A partial clock
+		for(int clock = 0; clock < TRACE_PLAY_CLOCKS; clock++){
+			//Resets together with the clock and in the middle of a step
+			bool resetWithClock = clock == 17 || clock == 61;
+			int resetMidStep = clock == 33 || clock == 75 ? TRACE_CLOCK_PERIOD / 4 : -1;
+			if(clock % 3 == 0 && scenario.stepCV != STEP_CV_NONE) vault.inputs[ChordVault::STEP_CV_INPUT].setVoltage(getStepCV());
+			if(scenario.knobMoves && clock % 11 == 5){
+				vault.params[ChordVault::STEP_KNOB_PARAM].setValue(pattern.next() % TRACE_RECORD_STEPS);
+			}
+			if(scenario.lengthCV && clock % 13 == 0){
+				vault.inputs[ChordVault::LENGTH_CV_INPUT].setVoltage((int)(pattern.next() % 51) / 10.f);
+			}
+			for(int i = 0; i < TRACE_CLOCK_PERIOD; i++){
+				vault.inputs[ChordVault::CLOCK_INPUT].setVoltage(i < TRACE_CLOCK_PERIOD / 2 ? 10.f : 0.f);
+				bool reset = (resetWithClock && i < 3) || (resetMidStep >= 0 && i >= resetMidStep && i < resetMidStep + 3);
+				vault.inputs[ChordVault::RESET_INPUT].setVoltage(reset ? 10.f : 0.f);
+				//The step CV of the CV modes also moves between clocks
+				if(i == TRACE_CLOCK_PERIOD / 2 && clock % 5 == 2 && scenario.stepCV != STEP_CV_NONE){
+					vault.inputs[ChordVault::STEP_CV_INPUT].setVoltage(getStepCV());
+				}
+				step();
+			}
+		}
+	}
+
+	std::string run(){
+		for(int i = 0; i < 5; i++) step();
+		record();
+		pressButton(ChordVault::RECORD_PLAY_BTN_PARAM);
+		if(scenario.offset) pressButton(ChordVault::OFFSET_BTN_PARAM);
+		play();
+		return trace.str();
+	}
+};
+
+int main(int argc, char** argv){
+	const char* program = argv[0];
+	if(argc == 4 && !strcmp(argv[1], "--default-rate")){
+		defaultRate = true;
+		argc--;
+		argv++;
+	}
+	if(argc != 3 || (strcmp(argv[1], "--write") && strcmp(argv[1], "--check"))){
+		fprintf(stderr, "usage: %s [--default-rate] --write|--check <dir>\n", program);
+		return 2;
+	}
+	bool write = !strcmp(argv[1], "--write");
+	std::string dir = argv[2];
+
+	int failed = 0;
+	for(const Scenario& scenario : SCENARIOS){
+		TracePatch* patch = new TracePatch(scenario);
+		std::string trace = patch->run();
+		delete patch;
+		std::string path = dir + "/" + scenario.name + ".txt";
+
+		if(write){
+			std::ofstream file(path);
+			file << trace;
+			printf("%-20s written\n", scenario.name);
+			continue;
+		}
+
+		std::ifstream file(path);
+		if(!file){
+			printf("%-20s FAIL, no %s\n", scenario.name, path.c_str());
+			failed++;
+			continue;
+		}
+		std::istringstream actual(trace);
+		std::string expectedLine, actualLine;
+		int lineNumber = 0;
+		bool ok = true;
+		while(true){
+			bool expectedMore = (bool)std::getline(file, expectedLine);
+			bool actualMore = (bool)std::getline(actual, actualLine);
+			lineNumber++;
+			if(!expectedMore && !actualMore) break;
+			if(!expectedMore) expectedLine = "<end>";
+			if(!actualMore) actualLine = "<end>";
+			if(expectedLine != actualLine){
+				printf("%-20s FAIL at line %d\n  expected: %s\n  actual:   %s\n", scenario.name, lineNumber, expectedLine.c_str(), actualLine.c_str());
+				ok = false;
+				break;
+			}
+		}
+		if(ok) printf("%-20s ok\n", scenario.name);
+		else failed++;
+	}
+	if(!write) printf("%d of %d scenarios differ\n", failed, (int)(sizeof SCENARIOS / sizeof SCENARIOS[0]));
+	return failed > 0;
+}
@@ -1,15 +1,104 @@
 #include "plugin.hpp"
+#include "ChordVault.hpp"
 #include "widgets.hpp"
 #include "util.hpp"
+#include "ChordVaultExpander.hpp"
+#include "ChordVaultRoll.hpp"
+#include "presetindex.hpp"
+#include "quantizer.hpp"
+#include "midifile.hpp"
+#include "perfstats.hpp"
+#include <osdialog.h>
+#include <climits>
 
 using namespace aetrion;
 
-#define VAULT_SIZE 16
-#define VAULT_SIZE_MINUS_1 15
-#define CHANNEL_COUNT 8
-#define PlayMode_MAX 8
+#define VAULT_SIZE_DEFAULT 16
+#define VAULT_SIZE_MAX 256
+#define CHANNEL_COUNT 16
+#define PlayMode_MAX 10
+#define STEP_WEIGHT_MAX 8
+#define STEP_WEIGHT_DEFAULT 1
+#define MARKOV_TARGETS 8
+#define MARKOV_WEIGHT_MAX 255 //Learned transitions keep their counts up to this, the menu editor stops at STEP_WEIGHT_MAX
+#define RATCHETS_MAX 8
+#define PROBABILITY_DEFAULT 100
+
+static_assert(VAULT_SIZE_MAX == SNAPSHOT_STEPS_MAX && CHANNEL_COUNT == SNAPSHOT_CHANNELS, "Snapshot size");
+
+#define GateLength_MAX 7
+//Percent of the clock period, 0 follows the clock input
+static int GateLength_OPTIONS [GateLength_MAX] = {0, 10, 25, 50, 75, 90, 100};
+
+#define Probability_MAX 7
+static int Probability_OPTIONS [Probability_MAX] = {100, 90, 75, 50, 25, 10, 0};
+
+#define GlideMode_MAX 2
+enum GlideMode {
+	GLIDE_CONSTANT_TIME,
+	GLIDE_CONSTANT_RATE,
+};
+
+static std::string GlideMode_LABELS [GlideMode_MAX] = {
+	"Constant Time",
+	"Constant Rate",
+};
+
+//Sections of process() that are timed when Performance > Measure is on
+#define PerfSection_MAX 10
+enum PerfSection {
+	PERF_COMMANDS,
+	PERF_BUTTONS,
+	PERF_LENGTH,
+	PERF_RESET,
+	PERF_CLOCK,
+	PERF_GATES,
+	PERF_STEP,
+	PERF_OUTPUTS,
+	PERF_SNAPSHOT,
+	PERF_TOTAL,
+};
+
+static std::string PerfSection_LABELS [PerfSection_MAX] = {
+	"Commands & chain",
+	"Buttons",
+	"Length CV & step knob",
+	"Reset",
+	"Clock",
+	"Gate detection",
+	"Step gate & strum",
+	"Outputs & glide",
+	"Piano roll snapshot",
+	"Total",
+};
+
+#define StrumMode_MAX 4
+
+enum StrumMode {
+	STRUM_OFF,
+	STRUM_UP,
+	STRUM_DOWN,
+	STRUM_ALTERNATE,
+};
+
+static std::string StrumMode_LABELS [StrumMode_MAX] = {
+	"Off",
+	"Up",
+	"Down",
+	"Alternate",
+};
+
+#define StrumTime_MAX 8
+//Delay between voices in ms
+static int StrumTime_OPTIONS [StrumTime_MAX] = {5, 10, 15, 20, 30, 50, 75, 100};
+
+#define StrumJitter_MAX 5
+//Maximum random extra delay per voice in ms
+static int StrumJitter_OPTIONS [StrumJitter_MAX] = {0, 2, 5, 10, 20};
 
 #define RndChordOption_MAX 16
+#define TRANSPOSE_MAX 12
+#define CHAIN_MAX 8
 
 enum PlayMode{
 	//Normal Modes
@@ -23,6 +112,10 @@ enum PlayMode{
 	PING_PONG,
 	SHUFFLE,
 	GLIDE,
+
+	//Menu only Modes
+	WEIGHTED,
+	MARKOV,
 };
 
 static std::string PLAY_MODE_NAMES [PlayMode_MAX] = {
@@ -34,6 +127,8 @@ static std::string PLAY_MODE_NAMES [PlayMode_MAX] = {
 	"Ping Pong",
 	"Shuffle",
 	"Glide",
+	"Weighted",
+	"Markov",
 };
 
 #define CVRange_MAX 3
@@ -50,6 +145,26 @@ static std::string CVRange_LABELS [CVRange_MAX] = {
 	"0 to 10V",
 };
 
+#define VaultSize_MAX 5
+
+static int VaultSize_OPTIONS[VaultSize_MAX] = {
+	16,
+	32,
+	64,
+	128,
+	256,
+};
+
+#define ControlRate_MAX 4
+
+//Number of samples between control rate updates, as offered in the context menu
+static int ControlRate_OPTIONS[ControlRate_MAX] = {
+	1,
+	16,
+	32,
+	64,
+};
+
 static int CVRange_Order[CVRange_MAX] = {
 	0, //0-5
 	2, //0-10
@@ -70,6 +185,10 @@ static std::string CVOrder_LABELS [CVOrder_MAX] = {
 	"Pristine",
 };
 
+static std::string ROOT_NOTE_LABELS [12] = {
+	"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B",
+};
+
 #define A_NOTE -3/12.f
 #define As_NOTE -2/12.f
 #define B_NOTE -1/12.f
@@ -99,6 +218,95 @@ float RndChordOption [RndChordOption_MAX][3] = {
 	{G_NOTE,As_NOTE,D_NOTE}, //G Minor
 };
 
+//Transitions out of one step for MARKOV mode. Only a few targets per step are kept, so a row is searched linearly.
+struct MarkovRow {
+	int count;
+	int target [MARKOV_TARGETS];
+	uint8_t weight [MARKOV_TARGETS];
+	//Running sum of the weights scaled to 1, one random value in [0, 1) picks the first entry it is below
+	float cumulative [MARKOV_TARGETS];
+
+	void update(){
+		int total = 0;
+		for(int ti = 0; ti < count; ti++) total += weight[ti];
+		int sum = 0;
+		for(int ti = 0; ti < count; ti++){
+			sum += weight[ti];
+			cumulative[ti] = sum / (float)total;
+		}
+	}
+
+	//Weight 0 removes the transition
+	void set(int to, int w){
+		int ti = 0;
+		while(ti < count && target[ti] != to) ti++;
+		if(w <= 0){
+			if(ti == count) return;
+			count--;
+			for(; ti < count; ti++){
+				target[ti] = target[ti + 1];
+				weight[ti] = weight[ti + 1];
+			}
+		}else{
+			if(ti == count){
+				if(count == MARKOV_TARGETS) return;
+				count++;
+				target[ti] = to;
+			}
+			weight[ti] = std::min(w, MARKOV_WEIGHT_MAX);
+		}
+		update();
+	}
+
+	int getWeight(int to){
+		for(int ti = 0; ti < count; ti++){
+			if(target[ti] == to) return weight[ti];
+		}
+		return 0;
+	}
+};
+
+//A voice of a strummed chord that starts its gate `delay` samples after the clock
+struct StrumEvent {
+	int delay;
+	int channel;
+};
+
+//One independent vault. The vault is stored as separate contiguous CV and gate arrays indexed by step,
+//sized for the largest vault. Only the first vaultSize steps are in use.
+struct VaultBank {
+	//Each step is a row of CHANNEL_COUNT floats, aligned so it can be read and written as float_4 lanes
+	alignas(16) float cv [VAULT_SIZE_MAX][CHANNEL_COUNT];
+	//Gates are stored as 1.f (high) or 0.f (low) so a row can be used directly as a SIMD mask source
+	alignas(16) float gate [VAULT_SIZE_MAX][CHANNEL_COUNT];
+	//Relative chance of each step being picked in WEIGHTED mode, 0 = never
+	uint8_t weight [VAULT_SIZE_MAX];
+	//Gate length in percent of the clock period, 0 lets the gate follow the clock input
+	uint8_t gateLength [VAULT_SIZE_MAX];
+	//Number of gates played within the step, 1-RATCHETS_MAX
+	uint8_t ratchets [VAULT_SIZE_MAX];
+	//Chance in percent that the step plays its gates
+	uint8_t probability [VAULT_SIZE_MAX];
+
+	void clear(){
+		memset(cv, 0, sizeof cv);
+		memset(gate, 0, sizeof gate);
+		memset(weight, STEP_WEIGHT_DEFAULT, sizeof weight);
+		memset(gateLength, 0, sizeof gateLength);
+		memset(ratchets, 1, sizeof ratchets);
+		memset(probability, PROBABILITY_DEFAULT, sizeof probability);
+	}
+
+	bool isEmpty(int size){
+		for(int si = 0; si < size; si++){
+			for(int ci = 0; ci < CHANNEL_COUNT; ci++){
+				if(gate[si][ci] > 0.f) return false;
+			}
+		}
+		return true;
+	}
+};
+
 struct ChordVault : Module {
 	enum ParamId {
 		STEP_KNOB_PARAM,
@@ -134,6 +342,55 @@ struct ChordVault : Module {
 		LIGHTS_LEN
 	};
 
+	//Context menu changes are queued by the UI thread and applied by the engine thread at the top of process()
+	enum CommandId {
+		SET_RECORDING_CMD,
+		SET_START_STEP_MODE_CMD,
+		SET_PLAY_MODE_CMD,
+		SET_BANK_CMD,
+		SET_CHANNELS_CMD,
+		SET_DYNAMIC_CHANNELS_CMD,
+		SET_SKIP_PARTIAL_CLOCK_CMD,
+		SET_VAULT_SIZE_CMD,
+		SET_CONTROL_RATE_CMD,
+		SET_CV_RANGE_CMD,
+		SET_CV_ORDER_CMD,
+		SHIFT_NOTES_CMD,
+		SET_RESEED_ON_RESET_CMD,
+		NEW_SEED_CMD,
+		SET_STEP_WEIGHT_CMD,
+		RESET_STEP_WEIGHTS_CMD,
+		SET_MARKOV_CMD,
+		CLEAR_MARKOV_STEP_CMD,
+		CLEAR_MARKOV_CMD,
+		LEARN_MARKOV_CMD,
+		SET_TRANSPOSE_CMD,
+		APPLY_TRANSPOSE_CMD,
+		SET_QUANTIZE_RECORD_CMD,
+		SET_QUANTIZE_OUTPUT_CMD,
+		SET_SCALE_ROOT_CMD,
+		SET_SCALE_CMD,
+		SET_TUNING_CMD,
+		IMPORT_MIDI_CMD,
+		SET_GATE_LENGTH_CMD,
+		SET_RATCHETS_CMD,
+		SET_PROBABILITY_CMD,
+		RESET_STEP_GATES_CMD,
+		SET_STRUM_MODE_CMD,
+		SET_STRUM_TIME_CMD,
+		SET_STRUM_JITTER_CMD,
+		SET_GLIDE_MODE_CMD,
+		SET_PERF_CMD,
+		RESET_PERF_CMD,
+	};
+
+	struct Command {
+		CommandId id;
+		int value;
+		int step;
+		int target;
+	};
+
 	struct SeqModeQuantity : ParamQuantity  {
 		std::string getDisplayValueString() override {
 			if(!module) return "";
@@ -163,20 +420,130 @@ struct ChordVault : Module {
 	int activeChannels;
 	int prev_raw_note;
 	float prev_raw_note_rnd;
+	dsp::ClockDivider controlDivider;
+	bool outputsDirty; //Set whenever the output voltages need to be rewritten
+	int pendingBank; //Bank that becomes active on the next clock
+	dsp::RingBuffer<Command, 64> commands; //Single producer (UI thread), single consumer (engine thread)
+	random::Xoroshiro128Plus rng; //Used for everything random so a seed always gives the same sequence
+	random::Xoroshiro128Plus strumRng; //Strum humanize only, so changing it doesn't change the sequence
+
+	//Alias table for WEIGHTED mode over the steps seqStart..seqStart+seqLength-1, rebuilt only when it is stale
+	float aliasProb [VAULT_SIZE_MAX];
+	int aliasIndex [VAULT_SIZE_MAX];
+	bool aliasDirty;
+	int aliasStart;
+	int aliasLength;
+
+	//Play order of FORWARD, BACKWARD and PING_PONG over the SEQ window, rebuilt only when the mode or the window changes.
+	//Playing the next step is a step through this table.
+	int order [2 * VAULT_SIZE_MAX];
+	int orderLength;
+	int orderIndex; //Entry of the current step
+	PlayMode orderMode;
+	int orderStart;
+	int orderSeqLength;
+
+	//Rows of the active bank. Switching banks only swaps these pointers, nothing is copied.
+	float (*vault_cv) [CHANNEL_COUNT];
+	float (*vault_gate) [CHANNEL_COUNT];
+
+	//CVs of the active bank as they are played, with the transpose applied. A row is rebuilt the next time it is played
+	//once its version no longer matches outCVVersion, so nothing is recomputed per sample.
+	alignas(16) float outCV [VAULT_SIZE_MAX][CHANNEL_COUNT];
+	uint32_t outCVRowVersion [VAULT_SIZE_MAX];
+	uint32_t outCVVersion;
+	float transposeCV; //Last value read from the expander TRANSPOSE input
+
+	PitchTable tuning; //Scala tuning, used when scale is Scale_MAX
+	PitchTable stagedTuning; //Filled by the UI thread, copied into tuning by SET_TUNING_CMD
+	//Imported MIDI chords, filled by the UI thread. IMPORT_MIDI_CMD swaps it with the active bank, the replaced bank is
+	//the staging bank of the next import.
+	VaultBank* stagedBank;
+	int stagedSteps;
+	//Set by the UI thread once a staging buffer is filled, cleared by the engine thread after copying it.
+	//The UI thread doesn't touch a staging buffer while its flag is set.
+	std::atomic<bool> stagedTuningPending;
+	std::atomic<bool> stagedBankPending;
+
+	ChainMessage chainMessages [2];
+	ExpanderMessage expanderMessages [2];
+	int chainIndex; //Position in a chain of ChordVaults, 0 for the first one, -1 when not chained
+	bool leftLinked; //The neighbor on that side is a ChordVault or an expander, so it gets chain messages
+	bool rightLinked;
+	int chainPos; //Position in the combined sequence, only used by the first ChordVault
+	int chainLength; //Combined sequence length, only used by the first ChordVault
+	bool chainGateHigh;
+	bool chainClockHigh; //Clock from the left neighbor, followers measure the clock period on it
+
+	//Step gate timers, all counted in samples
+	int clockCounter; //Samples since the last clock
+	int clockPeriod; //Samples between the last two clocks, 0 until two clocks were seen
+	bool stepGateTimed; //The current step uses the timers below instead of following the clock
+	bool stepMuted; //The current step lost its probability roll
+	bool stepGateHigh;
+	int ratchetSamples;
+	int gateSamples;
+	int ratchetsLeft;
+	int ratchetTimer;
+	int gateTimer;
+
+	//Strum, voice onsets waiting to start in the order they start
+	dsp::RingBuffer<StrumEvent, CHANNEL_COUNT> strumEvents;
+	StrumEvent strumNext; //Taken from strumEvents and waiting for its onset when strumPending is set
+	bool strumPending;
+	alignas(16) float strumMask [CHANNEL_COUNT]; //1.f once a voice of the current step has started
+	int strumTimer; //Samples since the step started
+	bool strumUpwards; //Direction of the next chord in STRUM_ALTERNATE
+
+	//Glide, the CV outputs slew from glideCV to glideTarget by up to glideSpeed volts per sample
+	alignas(16) float glideCV [CHANNEL_COUNT];
+	alignas(16) float glideTarget [CHANNEL_COUNT];
+	alignas(16) float glideSpeed [CHANNEL_COUNT];
+	bool glideActive; //Some voice hasn't reached its target yet
+	float glideSamples; //Glide time from the expander, below 1 the outputs jump straight to the target
+
+	//Piano roll snapshots, only published while a ChordVault Roll is attached
+	dsp::ClockDivider snapshotDivider;
+	ChordVaultRoll* snapshotRoll;
+	bool snapshotDirty; //The CVs or gates changed since the last snapshot
+	uint32_t snapshotVersion;
+
+	//Opt-in timing of the sections of process(), not saved with the patch
+	bool perfEnabled;
+	PerfHistogram perf [PerfSection_MAX];
 
 	//Persisted
 
-	float vault_cv [VAULT_SIZE][CHANNEL_COUNT];
-	bool vault_gate [VAULT_SIZE][CHANNEL_COUNT];
+	VaultBank* banks [BANK_COUNT]; //Point into bankStorage, the MIDI import swaps them like bank switching swaps the rows
+	int bank;
+	int selectedBank; //Bank chosen from the context menu
+	int transpose; //Semitones added to the played back notes, the recorded notes are not changed
+	bool quantizeRecord;
+	bool quantizeOutput;
+	int scaleRoot; //Semitones above C
+	int scale; //Index into SCALES, Scale_MAX for the loaded Scala tuning
+	//Text of the loaded Scala files so the tuning can be rebuilt when the patch is loaded. Only used by the UI thread.
+	std::string sclText;
+	std::string kbmText;
+	MarkovRow markov [VAULT_SIZE_MAX]; //Shared by all banks
+	VaultBank bankStorage [BANK_COUNT + 1]; //The banks and the staging bank
+	int vaultSize;
 	int vault_pos;
 	bool recording;
 	int channels;
 	bool dynamicChannels;
 	bool startStepMode;
 	bool skipPartialClock;
+	StrumMode strumMode;
+	int strumTime; //ms between voices
+	int strumJitter; //ms
+	GlideMode glideMode;
+	int controlRate; //Number of samples between updates of the buttons, lights, knobs and length CV
+	uint64_t seed;
+	bool reseedOnReset; //Restart the random generator from the seed on every reset
 
 	int shuffle_index;
-	int shuffle_arr [VAULT_SIZE];
+	int shuffle_arr [VAULT_SIZE_MAX];
 
 	PlayMode playMode;
 	CVRange cvRange;
@@ -203,6 +570,24 @@ struct ChordVault : Module {
 		configOutput(GATE_OUT_OUTPUT, "Gates");
 		configOutput(CV_OUT_OUTPUT, "V/octs");
 
+		memset(chainMessages, 0, sizeof chainMessages);
+		memset(expanderMessages, 0, sizeof expanderMessages);
+		leftExpander.producerMessage = &chainMessages[0];
+		leftExpander.consumerMessage = &chainMessages[1];
+		rightExpander.producerMessage = &expanderMessages[0];
+		rightExpander.consumerMessage = &expanderMessages[1];
+		leftLinked = false;
+		rightLinked = false;
+
+		snapshotDivider.setDivision(512);
+		snapshotRoll = NULL;
+		snapshotVersion = 0;
+		perfEnabled = false;
+		stagedTuningPending = false;
+		stagedBankPending = false;
+		for(int bi = 0; bi < BANK_COUNT; bi++) banks[bi] = &bankStorage[bi];
+		stagedBank = &bankStorage[BANK_COUNT];
+
 		initalize();
 	}
 
@@ -212,17 +597,20 @@ struct ChordVault : Module {
 
 		//Clear output volgates on reset
 		for(int ci = 0; ci < CHANNEL_COUNT; ci++) outputs[CV_OUT_OUTPUT].setVoltage(0,ci);
+		outputsDirty = true;
 	}
 
 	void onRandomize (const RandomizeEvent& e) override {
 		Module::onRandomize(e);
-		for(int si = 0; si < VAULT_SIZE; si ++){
-			int chordIndex = floor(rack::random::uniform() * RndChordOption_MAX);
+		for(int si = 0; si < vaultSize; si ++){
+			int chordIndex = floor(uniform() * RndChordOption_MAX);
 			for(int ci = 0; ci < 3; ci++){
-				vault_gate[si][ci] = true;
+				vault_gate[si][ci] = 1.f;
 				vault_cv[si][ci] = RndChordOption[chordIndex][ci];
 			}
 		}
+		invalidateOutCVs();
+		outputsDirty = true;
 	}
 
 	void initalize(){
@@ -242,31 +630,87 @@ struct ChordVault : Module {
 		stepSelect_prev = 0;
 		stepSelect_previewGateTimer = 0;
 		pingPongDir = false;
+		orderLength = 0;
+		orderIndex = 0;
 		prev_raw_note = 0;
 		prev_raw_note_rnd = 0.f;
-
-		memset(vault_cv, 0, sizeof vault_cv);
-		memset(vault_gate, 0, sizeof vault_gate);
+		outputsDirty = true;
+		aliasDirty = true;
+		chainIndex = -1;
+		chainPos = 0;
+		chainLength = 0;
+		chainGateHigh = false;
+		chainClockHigh = false;
+		clockCounter = 0;
+		clockPeriod = 0;
+		stepGateTimed = false;
+		stepMuted = false;
+		stepGateHigh = false;
+		stopStrum();
+		strumUpwards = true;
+		strumMode = STRUM_OFF;
+		strumTime = 20;
+		strumJitter = 0;
+		memset(glideCV, 0, sizeof glideCV);
+		memset(glideTarget, 0, sizeof glideTarget);
+		memset(glideSpeed, 0, sizeof glideSpeed);
+		glideActive = false;
+		glideSamples = 0.f;
+		glideMode = GLIDE_CONSTANT_TIME;
+		snapshotDirty = true;
+
+		for(int bi = 0; bi < BANK_COUNT; bi++) banks[bi]->clear();
+		memset(markov, 0, sizeof markov);
+		memset(outCVRowVersion, 0, sizeof outCVRowVersion);
+		outCVVersion = 1;
+		transpose = 0;
+		transposeCV = 0.f;
+		quantizeRecord = false;
+		quantizeOutput = false;
+		scaleRoot = 0;
+		scale = 1; //Major
+		tuning.count = 0;
+		sclText = "";
+		kbmText = "";
+		selectedBank = 0;
+		pendingBank = 0;
 		vault_pos = 0;
 		recording = true;	
 		channels = 5;
 		dynamicChannels = false;
 		startStepMode = false;
 		skipPartialClock = false;
+		setControlRate(32);
+		reseedOnReset = false;
+		setSeed(random::u64());
 		playMode = (PlayMode)0;	
 		cvRange = CVRange::ZeroTo5V;
 		cvOrder = CVOrder::Sorted;
 		shuffle_index = 0;
-		for(int i = 0; i < VAULT_SIZE; i++) shuffle_arr[i] = i;
+		for(int i = 0; i < VAULT_SIZE_MAX; i++) shuffle_arr[i] = i;
 
 
 		activeChannels = channels;
+		setBank(0);
+		setVaultSize(VAULT_SIZE_DEFAULT);
 
 	}
 
 	json_t *dataToJson() override{
 		json_t *jobj = json_object();
+		json_object_set_new(jobj, "vaultSize", json_integer(vaultSize));
+		json_object_set_new(jobj, "bank", json_integer(bank));
+		json_object_set_new(jobj, "selectedBank", json_integer(selectedBank));
+		json_object_set_new(jobj, "transpose", json_integer(transpose));
+		json_object_set_new(jobj, "quantizeRecord", json_bool(quantizeRecord));
+		json_object_set_new(jobj, "quantizeOutput", json_bool(quantizeOutput));
+		json_object_set_new(jobj, "scaleRoot", json_integer(scaleRoot));
+		json_object_set_new(jobj, "scale", json_integer(scale));
+		if(!sclText.empty()) json_object_set_new(jobj, "scl", json_string(sclText.c_str()));
+		if(!kbmText.empty()) json_object_set_new(jobj, "kbm", json_string(kbmText.c_str()));
 		json_object_set_new(jobj, "vault_pos", json_integer(vault_pos));
+		json_object_set_new(jobj, "stepKnob", json_integer((int)params[STEP_KNOB_PARAM].getValue()));
+		json_object_set_new(jobj, "lengthKnob", json_integer((int)params[LENGTH_KNOB_PARAM].getValue()));
 		json_object_set_new(jobj, "playMode", json_integer(playMode));
 		json_object_set_new(jobj, "cvRange", json_integer(cvRange));
 		json_object_set_new(jobj, "cvOrder", json_integer(cvOrder));
@@ -276,189 +720,447 @@ struct ChordVault : Module {
 		json_object_set_new(jobj, "dynamicChannels", json_bool(dynamicChannels));
 		json_object_set_new(jobj, "startStepMode", json_bool(startStepMode));
 		json_object_set_new(jobj, "skipPartialClock", json_bool(skipPartialClock));
+		json_object_set_new(jobj, "strumMode", json_integer(strumMode));
+		json_object_set_new(jobj, "strumTime", json_integer(strumTime));
+		json_object_set_new(jobj, "strumJitter", json_integer(strumJitter));
+		json_object_set_new(jobj, "glideMode", json_integer(glideMode));
+		json_object_set_new(jobj, "controlRate", json_integer(controlRate));
+		json_object_set_new(jobj, "seed", json_string(string::f("%016llx", (unsigned long long)seed).c_str()));
+		json_object_set_new(jobj, "reseedOnReset", json_bool(reseedOnReset));
 		
 
-		json_t *vaultJ = json_array();
-		json_t *shuffle_arrJ = json_array();
-		for(int vi = 0; vi < VAULT_SIZE; vi++){
-			json_t *vaultRowJ = json_object();
-			json_object_set_new(vaultRowJ, "cv", json_floatArray(vault_cv[vi],CHANNEL_COUNT));
-			json_object_set_new(vaultRowJ, "gate", json_boolArray(vault_gate[vi],CHANNEL_COUNT));
-			json_array_insert_new(vaultJ, vi, vaultRowJ);
-
-			json_array_insert_new(shuffle_arrJ, vi, json_integer(shuffle_arr[vi]));
+		stepBytesToJson(jobj, "stepWeights", &VaultBank::weight, STEP_WEIGHT_DEFAULT);
+		stepBytesToJson(jobj, "stepGateLengths", &VaultBank::gateLength, 0);
+		stepBytesToJson(jobj, "stepRatchets", &VaultBank::ratchets, 1);
+		stepBytesToJson(jobj, "stepProbabilities", &VaultBank::probability, PROBABILITY_DEFAULT);
+
+		//Markov transitions as [step, [target, weight], ...] for every step that has any
+		json_t *markovJ = json_array();
+		for(int si = 0; si < vaultSize; si++){
+			if(markov[si].count == 0) continue;
+			json_t *rowJ = json_array();
+			json_array_append_new(rowJ, json_integer(si));
+			for(int ti = 0; ti < markov[si].count; ti++){
+				json_t *transitionJ = json_array();
+				json_array_append_new(transitionJ, json_integer(markov[si].target[ti]));
+				json_array_append_new(transitionJ, json_integer(markov[si].weight[ti]));
+				json_array_append_new(rowJ, transitionJ);
+			}
+			json_array_append_new(markovJ, rowJ);
 		}
+		json_object_set_new(jobj, "markov", markovJ);
 
-		json_object_set_new(jobj, "vault", vaultJ);
-		json_object_set_new(jobj, "shuffle_arr", shuffle_arrJ);
+		std::vector<uint8_t> vaultData = packVault();
+		json_object_set_new(jobj, "vaultData", json_string(string::toBase64(vaultData.data(), vaultData.size()).c_str()));
 
 		return jobj;
 	}
 
 	void dataFromJson(json_t *jobj) override {
+		//Patches from before the vault size was configurable have 16 steps
+		json_t *vaultSizeJ = json_object_get(jobj, "vaultSize");
+		setVaultSize(vaultSizeJ ? json_integer_value(vaultSizeJ) : VAULT_SIZE_DEFAULT);
+		//The knob values are clamped to the default range when the params are loaded, so restore them here
+		json_t *stepKnobJ = json_object_get(jobj, "stepKnob");
+		if(stepKnobJ) params[STEP_KNOB_PARAM].setValue(clamp((int)json_integer_value(stepKnobJ), 0, vaultSize - 1));
+		json_t *lengthKnobJ = json_object_get(jobj, "lengthKnob");
+		if(lengthKnobJ) params[LENGTH_KNOB_PARAM].setValue(clamp((int)json_integer_value(lengthKnobJ), 1, vaultSize));
+		for(int bi = 0; bi < BANK_COUNT; bi++) banks[bi]->clear();
+		json_t *vaultDataJ = json_object_get(jobj,"vaultData");
+		json_t *banksJ = json_object_get(jobj,"banks");
+		if(vaultDataJ){
+			unpackVault(string::fromBase64(json_string_value(vaultDataJ)));
+		}else if(banksJ){
+			//Banks saved as JSON arrays, before the packed format
+			for(int bi = 0; bi < BANK_COUNT; bi++){
+				json_t *bankJ = json_array_get(banksJ,bi);
+				if(bankJ && !json_is_null(bankJ)) vaultFromJson(bankJ, *banks[bi]);
+			}
+		}else{
+			//Patches from before banks were added only have a single vault
+			vaultFromJson(json_object_get(jobj,"vault"), *banks[0]);
+		}
+		json_t *bankJ = json_object_get(jobj, "bank");
+		int loadedBank = bankJ ? clamp((int)json_integer_value(bankJ), 0, BANK_COUNT - 1) : 0;
+		stepBytesFromJson(jobj, "stepWeights", &VaultBank::weight, 0, STEP_WEIGHT_MAX);
+		stepBytesFromJson(jobj, "stepGateLengths", &VaultBank::gateLength, 0, 100);
+		stepBytesFromJson(jobj, "stepRatchets", &VaultBank::ratchets, 1, RATCHETS_MAX);
+		stepBytesFromJson(jobj, "stepProbabilities", &VaultBank::probability, 0, 100);
+		aliasDirty = true;
+
+		memset(markov, 0, sizeof markov);
+		json_t *markovJ = json_object_get(jobj, "markov");
+		for(size_t ri = 0; ri < json_array_size(markovJ); ri++){
+			json_t *rowJ = json_array_get(markovJ, ri);
+			int si = json_integer_value(json_array_get(rowJ, 0));
+			if(si < 0 || si >= vaultSize) continue;
+			for(size_t ti = 1; ti < json_array_size(rowJ); ti++){
+				json_t *transitionJ = json_array_get(rowJ, ti);
+				int target = json_integer_value(json_array_get(transitionJ, 0));
+				if(target < 0 || target >= vaultSize) continue;
+				markov[si].set(target, json_integer_value(json_array_get(transitionJ, 1)));
+			}
+		}
+
+		transpose = clamp((int)json_integer_value(json_object_get(jobj, "transpose")), -TRANSPOSE_MAX, TRANSPOSE_MAX);
+		quantizeRecord = json_is_true(json_object_get(jobj, "quantizeRecord"));
+		quantizeOutput = json_is_true(json_object_get(jobj, "quantizeOutput"));
+		scaleRoot = clamp((int)json_integer_value(json_object_get(jobj, "scaleRoot")), 0, 11);
+		json_t *scaleJ = json_object_get(jobj, "scale");
+		scale = scaleJ ? clamp((int)json_integer_value(scaleJ), 0, Scale_MAX) : 1;
+		json_t *sclJ = json_object_get(jobj, "scl");
+		json_t *kbmJ = json_object_get(jobj, "kbm");
+		sclText = sclJ ? json_string_value(sclJ) : "";
+		kbmText = kbmJ ? json_string_value(kbmJ) : "";
+		std::string error;
+		tuning.count = 0;
+		if(!sclText.empty() && !parseScala(sclText, kbmText, tuning, error)) WARN("ChordVault: %s", error.c_str());
+		if(scale == Scale_MAX && tuning.count == 0) scale = 0;
+
+		json_t *selectedBankJ = json_object_get(jobj, "selectedBank");
+		selectedBank = selectedBankJ ? clamp((int)json_integer_value(selectedBankJ), 0, BANK_COUNT - 1) : loadedBank;
+		pendingBank = selectedBank;
+		setBank(loadedBank);
+
 		setVaultPos(json_integer_value(json_object_get(jobj, "vault_pos")));
 		playMode = (PlayMode)json_integer_value(json_object_get(jobj, "playMode"));
 		cvRange = (CVRange)json_integer_value(json_object_get(jobj, "cvRange"));
 		cvOrder = (CVOrder)json_integer_value(json_object_get(jobj, "cvOrder"));
-		channels = json_integer_value(json_object_get(jobj, "channels"));
+		channels = clamp((int)json_integer_value(json_object_get(jobj, "channels")), 1, CHANNEL_COUNT);
 		shuffle_index = json_integer_value(json_object_get(jobj, "shuffle_index"));
 		recording = json_is_true(json_object_get(jobj, "recording"));
 		dynamicChannels = json_is_true(json_object_get(jobj, "dynamicChannels"));
 		startStepMode = json_is_true(json_object_get(jobj, "startStepMode"));
 		skipPartialClock = json_is_true(json_object_get(jobj, "skipPartialClock"));
+		strumMode = (StrumMode)clamp((int)json_integer_value(json_object_get(jobj, "strumMode")), 0, StrumMode_MAX - 1);
+		json_t *strumTimeJ = json_object_get(jobj, "strumTime");
+		if(strumTimeJ) strumTime = clamp((int)json_integer_value(strumTimeJ), 0, 100);
+		strumJitter = clamp((int)json_integer_value(json_object_get(jobj, "strumJitter")), 0, 100);
+		glideMode = (GlideMode)clamp((int)json_integer_value(json_object_get(jobj, "glideMode")), 0, GlideMode_MAX - 1);
+		json_t *controlRateJ = json_object_get(jobj, "controlRate");
+		if(controlRateJ) setControlRate(json_integer_value(controlRateJ));
+		//Stored as a hex string because JSON integers are signed
+		json_t *seedJ = json_object_get(jobj, "seed");
+		if(seedJ) setSeed(strtoull(json_string_value(seedJ), NULL, 16));
+		reseedOnReset = json_is_true(json_object_get(jobj, "reseedOnReset"));
 		
 
-		json_t *vaultJ = json_object_get(jobj,"vault");
 		json_t *shuffle_arrJ = json_object_get(jobj,"shuffle_arr");
-		for(int vi = 0; vi < VAULT_SIZE; vi++){
-			json_t *vaultRowJ = json_array_get(vaultJ,vi);
-			json_floatArray_value(json_object_get(vaultRowJ,"cv"),vault_cv[vi],CHANNEL_COUNT);
-			json_boolArray_value(json_object_get(vaultRowJ,"gate"),vault_gate[vi],CHANNEL_COUNT);
-			shuffle_arr[vi] = json_integer_value(json_array_get(shuffle_arrJ,vi));
+		if(shuffle_arrJ){
+			int shuffleRows = std::min((int)json_array_size(shuffle_arrJ), vaultSize);
+			for(int vi = 0; vi < shuffleRows; vi++){
+				shuffle_arr[vi] = json_integer_value(json_array_get(shuffle_arrJ,vi));
+			}
 		}
 
 		//Set this to update the light after loading
 		firstProcess = true;
+		outputsDirty = true;
+	}
+
+	//Per step settings are stored base64 encoded, one byte per step for every bank.
+	//The key is left out while every step has the default value.
+	void stepBytesToJson(json_t *jobj, const char* key, uint8_t (VaultBank::*field)[VAULT_SIZE_MAX], uint8_t defaultValue){
+		bool allDefault = true;
+		std::vector<uint8_t> bytes;
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			for(int si = 0; si < vaultSize; si++){
+				if((banks[bi]->*field)[si] != defaultValue) allDefault = false;
+				bytes.push_back((banks[bi]->*field)[si]);
+			}
+		}
+		if(!allDefault) json_object_set_new(jobj, key, json_string(string::toBase64(bytes.data(), bytes.size()).c_str()));
+	}
+
+	void stepBytesFromJson(json_t *jobj, const char* key, uint8_t (VaultBank::*field)[VAULT_SIZE_MAX], int minValue, int maxValue){
+		json_t *bytesJ = json_object_get(jobj, key);
+		if(!bytesJ) return;
+		std::vector<uint8_t> bytes = string::fromBase64(json_string_value(bytesJ));
+		if(bytes.size() != (size_t)BANK_COUNT * vaultSize) return;
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			for(int si = 0; si < vaultSize; si++){
+				(banks[bi]->*field)[si] = clamp((int)bytes[bi * vaultSize + si], minValue, maxValue);
+			}
+		}
+	}
+
+	//Packed vault format, stored base64 encoded in "vaultData". All values are little-endian.
+	//  u8  format version (VAULT_DATA_VERSION)
+	//  u16 vault size
+	//  u8  channel count
+	//  u16 bitmask of the banks that follow, empty banks are left out
+	//  per bank, per step: gate bitmask (one bit per channel, (channels + 7) / 8 bytes) followed by one f32 CV per channel
+	//  u8 per step: shuffle_arr
+	std::vector<uint8_t> packVault(){
+		int gateBytes = (CHANNEL_COUNT + 7) / 8;
+		uint16_t bankMask = 0;
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			if(!banks[bi]->isEmpty(vaultSize)) bankMask |= 1 << bi;
+		}
+
+		std::vector<uint8_t> data;
+		data.reserve(6 + BANK_COUNT * vaultSize * (gateBytes + CHANNEL_COUNT * 4) + vaultSize);
+		pack_u8(data, VAULT_DATA_VERSION);
+		pack_u16(data, vaultSize);
+		pack_u8(data, CHANNEL_COUNT);
+		pack_u16(data, bankMask);
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			if(!(bankMask & (1 << bi))) continue;
+			for(int si = 0; si < vaultSize; si++){
+				for(int byte = 0; byte < gateBytes; byte++){
+					uint8_t gateBits = 0;
+					for(int bit = 0; bit < 8 && byte * 8 + bit < CHANNEL_COUNT; bit++){
+						if(banks[bi]->gate[si][byte * 8 + bit] > 0.f) gateBits |= 1 << bit;
+					}
+					pack_u8(data, gateBits);
+				}
+				for(int ci = 0; ci < CHANNEL_COUNT; ci++){
+					pack_f32(data, banks[bi]->cv[si][ci]);
+				}
+			}
+		}
+		for(int si = 0; si < vaultSize; si++){
+			pack_u8(data, shuffle_arr[si]);
+		}
+		return data;
+	}
+
+	//Returns false and leaves the vault untouched if the data is not valid
+	bool unpackVault(const std::vector<uint8_t>& data){
+		if(data.size() < 6 || data[0] != VAULT_DATA_VERSION) return false;
+		int size = unpack_u16(&data[1]);
+		int channelCount = data[3];
+		uint16_t bankMask = unpack_u16(&data[4]);
+		int gateBytes = (channelCount + 7) / 8;
+		int stepBytes = gateBytes + channelCount * 4;
+
+		int bankCount = 0;
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			if(bankMask & (1 << bi)) bankCount++;
+		}
+		if(size > VAULT_SIZE_MAX || data.size() != 6 + (size_t)bankCount * size * stepBytes + size) return false;
+
+		const uint8_t* p = &data[6];
+		for(int bi = 0; bi < BANK_COUNT; bi++){
+			if(!(bankMask & (1 << bi))) continue;
+			for(int si = 0; si < size; si++){
+				const uint8_t* gateBits = p;
+				const uint8_t* cvs = p + gateBytes;
+				for(int ci = 0; ci < channelCount && ci < CHANNEL_COUNT; ci++){
+					banks[bi]->gate[si][ci] = (gateBits[ci / 8] >> (ci % 8)) & 1 ? 1.f : 0.f;
+					banks[bi]->cv[si][ci] = unpack_f32(cvs + ci * 4);
+				}
+				p += stepBytes;
+			}
+		}
+		for(int si = 0; si < size; si++){
+			shuffle_arr[si] = p[si];
+		}
+		return true;
+	}
+
+	void vaultFromJson(json_t *vaultJ, VaultBank& vault){
+		int vaultRows = std::min((int)json_array_size(vaultJ), vaultSize);
+		for(int vi = 0; vi < vaultRows; vi++){
+			json_t *vaultRowJ = json_array_get(vaultJ,vi);
+			json_floatArray_value(json_object_get(vaultRowJ,"cv"),vault.cv[vi],CHANNEL_COUNT);
+			json_boolArray_value(json_object_get(vaultRowJ,"gate"),vault.gate[vi],CHANNEL_COUNT);
+		}
 	}
 
 	void processBypass(const ProcessArgs& args) override{
+		processCommands();
+
 		//Even in bypass keep the number of output channels the same. This prevents clicking when connecte to some VCOs like Macro Oscillator 2
 		outputs[CV_OUT_OUTPUT].setChannels(activeChannels);
 		outputs[GATE_OUT_OUTPUT].setChannels(activeChannels);
+
+		//Rack clears the outputs while bypassed, so they have to be rewritten afterwards
+		outputsDirty = true;
 	}
 
 	void process(const ProcessArgs& args) override {
+		PerfLap perfLap(perfEnabled);
 
-		outputs[CV_OUT_OUTPUT].setChannels(activeChannels);
-		outputs[GATE_OUT_OUTPUT].setChannels(activeChannels);
+		processCommands();
+		updateChain();
+
+		//A newly connected cable resets the output channel count, so the outputs need a rewrite
+		if(isOutputStale(CV_OUT_OUTPUT) || isOutputStale(GATE_OUT_OUTPUT)) outputsDirty = true;
+		perfLap.lap(perf[PERF_COMMANDS]);
+
+		bool controlTick = controlDivider.process();
 
 		if(firstProcess){
 			firstProcess = false;			
 			stepSelect_prev = (int)params[STEP_KNOB_PARAM].getValue();
 			updatePlayModeLights();
 			updateRecordModeLights();
+			//Make sure lengths and lights are valid on the very first sample
+			controlTick = true;
 		}
 
-		//Toggle Record mode if Button is down
-		{
-			float btnValue = params[RECORD_PLAY_BTN_PARAM].getValue();
-			if(recordPlayBtnDown && btnValue <= 0){
-				recordPlayBtnDown = false;
-			}else if(!recordPlayBtnDown && btnValue > 0){
-				recordPlayBtnDown = true;
-				recording = !recording;
-				updateRecordModeLights();
+		//Buttons, lights, knobs and the length CV are UI-facing, so they only run at control rate.
+		//Clock, reset and gate edges below stay sample accurate.
+		bool resetBtnPressed = false;
+		if(controlTick){
+			int controlFrames = controlDivider.getDivision();
 
-				if(recording){
-					//When changing play -> record do NOT change the position
-				}else{
-					//When changing record -> play mode reset play position
-					setVaultPos(seqStart);
-					partialPlayClock = skipPartialClock;
+			//Toggle Record mode if Button is down
+			{
+				float btnValue = params[RECORD_PLAY_BTN_PARAM].getValue();
+				if(recordPlayBtnDown && btnValue <= 0){
+					recordPlayBtnDown = false;
+				}else if(!recordPlayBtnDown && btnValue > 0){
+					recordPlayBtnDown = true;
+					recording = !recording;
+					updateRecordModeLights();
+					outputsDirty = true;
+
+					if(recording){
+						//When changing play -> record do NOT change the position
+					}else{
+						//When changing record -> play mode reset play position
+						setVaultPos(seqStart);
+						partialPlayClock = skipPartialClock;
 
-					//If done recording sort the current CVs
-					sortAndClearCurrentCVs();
+						//If done recording sort the current CVs
+						sortAndClearCurrentCVs();
+					}
 				}
 			}
-		}
 
-		//Offset Mode
-		{
-			//Toggle Offset mode if Button is down
-			float btnValue = params[OFFSET_BTN_PARAM].getValue();
-			if(offsetBtnDown && btnValue <= 0){
-				offsetBtnDown = false;
-			}else if(!offsetBtnDown && btnValue > 0){
-				offsetBtnDown = true;
-				if(startStepMode){
-					startStepMode = false;
-					seqStart = 0; //When leaving the mode reset the sequence offset/start back to 0
-				}else{
-					startStepMode = true;
+			//Offset Mode
+			{
+				//Toggle Offset mode if Button is down
+				float btnValue = params[OFFSET_BTN_PARAM].getValue();
+				if(offsetBtnDown && btnValue <= 0){
+					offsetBtnDown = false;
+				}else if(!offsetBtnDown && btnValue > 0){
+					offsetBtnDown = true;
+					if(startStepMode){
+						startStepMode = false;
+						seqStart = 0; //When leaving the mode reset the sequence offset/start back to 0
+					}else{
+						startStepMode = true;
+					}
 				}
+
+				//Update Light
+				lights[OFFSET_LIGHT_LIGHT].setBrightness(startStepMode ? 1.f : 0.f);
 			}
 
-			//Update Light
-			lights[OFFSET_LIGHT_LIGHT].setBrightness(startStepMode ? 1.f : 0.f);
-		}
+			//Seq Mode Button
+			{
+				float btnValue = params[PLAY_MODE_PARAM].getValue();
+				if(playModeBtnDown && btnValue <= 0){
+					playModeBtnDown = false;
+					if(playModeBtnDown_counter > 0){
+						playModeBtnDown_counter = 0;
+
+						//Only advance mode on release and if long press didn't trigger
+						int pmi = playMode;
+						pmi++;
+						if(pmi == 4) pmi = 0;
+						if(pmi == 8) pmi = 4;
+						if(pmi > 8) pmi = 0; //Leaving a menu only mode
+						playMode = (PlayMode) pmi;
+
+						updatePlayModeLights();	
+					}
+				}else if(!playModeBtnDown && btnValue > 0){
+					playModeBtnDown = true;
+					playModeBtnDown_counter = args.sampleRate;							
+				}
 
-		//Seq Mode Button
-		{
-			float btnValue = params[PLAY_MODE_PARAM].getValue();
-			if(playModeBtnDown && btnValue <= 0){
-				playModeBtnDown = false;
-				if(playModeBtnDown_counter > 0){
-					playModeBtnDown_counter = 0;
-
-					//Only advance mode on release and if long press didn't trigger
-					int pmi = playMode;
-					pmi++;
-					if(pmi == 4) pmi = 0;
-					if(pmi == 8) pmi = 4;
-					playMode = (PlayMode) pmi;
-
-					updatePlayModeLights();	
+				if(playModeBtnDown && playModeBtnDown_counter > 0){
+					playModeBtnDown_counter -= controlFrames;
+					if(playModeBtnDown_counter <= 0){
+						playModeBtnDown_counter = 0;
+						playMode = (PlayMode)((playMode + 4) % 8);
+						updatePlayModeLights();
+					}
 				}
-			}else if(!playModeBtnDown && btnValue > 0){
-				playModeBtnDown = true;
-				playModeBtnDown_counter = args.sampleRate;							
 			}
 
-			if(playModeBtnDown && playModeBtnDown_counter > 0){
-				playModeBtnDown_counter--;
-				if(playModeBtnDown_counter == 0){
-					playMode = (PlayMode)((playMode + 4) % PlayMode_MAX);
-					updatePlayModeLights();
+			//Reset Button
+			if(!recording){
+				float btnValue = params[RESET_BTN_PARAM].getValue();
+				if(resetBtnDown && btnValue <= 0){
+					resetBtnDown = false;
+				}else if(!resetBtnDown && btnValue > 0){
+					resetBtnDown = true;
+					resetBtnPressed = true;
 				}
 			}
-		}
 
-		if(inputs[LENGTH_CV_INPUT].isConnected()){
-			if(!recording){
-				//Playback Mode
-				seqLength = (int)(inputs[LENGTH_CV_INPUT].getVoltage() / 5.01f * (VAULT_SIZE));
-				while(seqLength < 0) seqLength += VAULT_SIZE;
-				while(seqLength >= VAULT_SIZE) seqLength -= VAULT_SIZE;
-				seqLength+=1;			
-				params[LENGTH_KNOB_PARAM].setValue(seqLength);
+			//Bank Select
+			//While playing from a clock the switch waits for the next clock edge, otherwise it happens right away
+			{
+				pendingBank = getTargetBank();
+				bool clocked = !recording && inputs[CLOCK_INPUT].isConnected();
+				if(pendingBank != bank && !clocked && !(recording && gatesHigh)){
+					setBank(pendingBank);
+				}
+			}
+
+			//Transpose CV and Glide
+			{
+				ExpanderMessage* expander = getExpanderMessage();
+				float cv = expander ? expander->transposeCV : 0.f;
+				if(cv != transposeCV){
+					transposeCV = cv;
+					invalidateOutCVs();
+				}
+				glideSamples = expander ? expander->glideTime * args.sampleRate : 0.f;
+			}
+
+			perfLap.lap(perf[PERF_BUTTONS]);
+
+			if(inputs[LENGTH_CV_INPUT].isConnected()){
+				if(!recording){
+					//Playback Mode
+					seqLength = (int)(inputs[LENGTH_CV_INPUT].getVoltage() / 5.01f * vaultSize);
+					seqLength = mod_0_max(seqLength, vaultSize) + 1;
+					params[LENGTH_KNOB_PARAM].setValue(seqLength);
+				}else{
+					//Don't animate Length knob when in record mode
+					//Also don't update the length display based on CV input when in record mode
+				}
 			}else{
-				//Don't animate Length knob when in record mode
-				//Also don't update the length display based on CV input when in record mode
+				seqLength = (int)params[LENGTH_KNOB_PARAM].getValue();
 			}
-		}else{
-			seqLength = (int)params[LENGTH_KNOB_PARAM].getValue();
-		}
 
-		bool inCVrelatedMode = playMode == CV || playMode == GLIDE;
-		if(startStepMode && !recording){			
-			seqStart = getSeqStartPos(!inCVrelatedMode);
-		}else{
-			int stepSelect = (int)params[STEP_KNOB_PARAM].getValue();
-			
-			if(stepSelect_prev != stepSelect){
-				stepSelect_prev = stepSelect;
-				vault_pos = stepSelect;
+			bool inCVrelatedMode = playMode == CV || playMode == GLIDE;
+			if(startStepMode && !recording){			
+				seqStart = getSeqStartPos(!inCVrelatedMode);
+			}else{
+				int stepSelect = (int)params[STEP_KNOB_PARAM].getValue();
 				
-				//When cycling through the steps trigger a fake/preview gate for a quarter second
-				stepSelect_previewGateTimer = args.sampleRate / 4;
+				if(stepSelect_prev != stepSelect){
+					stepSelect_prev = stepSelect;
+					vault_pos = stepSelect;
+					outputsDirty = true;
+					
+					//When cycling through the steps trigger a fake/preview gate for a quarter second
+					stepSelect_previewGateTimer = args.sampleRate / 4;
 
-				//Clear this to allow for previewing of steps
-				partialPlayClock = false;
-			}		
+					//Clear this to allow for previewing of steps
+					partialPlayClock = false;
+				}		
+			}
+			perfLap.lap(perf[PERF_LENGTH]);
 		}
 
-		if(!recording){
-			bool resetEvent = false;
-			//Reset Button
-			{
-				float btnValue = params[RESET_BTN_PARAM].getValue();
-				if(resetBtnDown && btnValue <= 0){
-					resetBtnDown = false;
-				}else if(!resetBtnDown && btnValue > 0){
-					resetBtnDown = true;
-					resetEvent = true;
-				}
-			}
+		//ChordVaults further down a chain follow the first one, their own clock and reset are ignored
+		bool chainFollower = chainIndex > 0;
+		if(chainFollower){
+			clockHigh = false;
+			partialPlayClock = false;
+		}
+
+		if(!recording && !chainFollower){
+			bool resetEvent = resetBtnPressed;
 
 			//Reset Trigger
 			{
@@ -473,7 +1175,16 @@ struct ChordVault : Module {
 			}
 
 			if(resetEvent){
+				outputsDirty = true;
+				if(reseedOnReset){
+					setSeed(seed);
+					shuffle_index = 0; //Rebuild the shuffle order from the fresh generator
+				}
 				setVaultPos(seqStart);
+				chainPos = 0;
+				stepGateTimed = false;
+				stepMuted = false;
+				stopStrum();
 				partialPlayClock = skipPartialClock; //set this to true to cause the next gate to play step 1
 
 				//Stop previewing on reset
@@ -481,26 +1192,47 @@ struct ChordVault : Module {
 			}
 		}
 
+		perfLap.lap(perf[PERF_RESET]);
+
 		//Clock Detection
 		//Do this after reset detection so that if clock and reset have the same clock we don't miss the first clock.
-		{
+		if(!chainFollower){
 			float clockValue = inputs[CLOCK_INPUT].getVoltage(); 
+			if(clockCounter < INT_MAX) clockCounter++;
 			if(clockHigh && clockValue <= 0.1f){
 				clockHigh = false;
+				outputsDirty = true;
 			}else if(!clockHigh && clockValue >= 2.0f){
 				clockHigh = true;
+				outputsDirty = true;
+				clockPeriod = clockCounter;
+				clockCounter = 0;
 
 				//VCV Timing Standard
 				resetLockout = 0.001; //1ms lockout for accepting reset trigger
 
 				//If not recording, the advance the step here (on clock high)
 				if(!recording){
+					//A pending bank switch lands exactly on the clock edge
+					pendingBank = getTargetBank();
+					if(pendingBank != bank) setBank(pendingBank);
+
 					if(partialPlayClock){
 						//Absorb the partical clock and don't advance the sequence
 						partialPlayClock = false;
-						setStartingVaultPosition();
+						if(chainIndex == 0) chainPos = 0;
+						else setStartingVaultPosition();
+						stepGateTimed = false;
+						stepMuted = false;
 					}else{
-						nextVaultPosition();
+						//In a chain the step gate and strum start once the chain has set the step of each ChordVault
+						if(chainIndex == 0){
+							nextChainPosition();
+						}else{
+							nextVaultPosition();
+							startStepGate();
+							startStrum(args.sampleRate);
+						}
 
 						//Stop previewing when when moving to next step
 						stepSelect_previewGateTimer = 0;
@@ -509,16 +1241,21 @@ struct ChordVault : Module {
 			}
 		}
 
+		perfLap.lap(perf[PERF_CLOCK]);
+
 		//Gate Detection
 		{
 			//When recording, use the max of all input gate values
 			//This means any gate down will cause a record and all gates must go low for the next record to happen
-			float maxGateValue = 0;
-			for(int ci = 0; ci < channels; ci++){
-				maxGateValue = std::max(maxGateValue,inputs[GATE_IN_INPUT].getVoltage(ci));
+			simd::float_4 maxGates = 0.f;
+			for(int ci = 0; ci < channels; ci += 4){
+				simd::float_4 inGates = inputs[GATE_IN_INPUT].getVoltageSimd<simd::float_4>(ci);
+				maxGates = simd::fmax(maxGates, simd::ifelse(getChannelMask(ci), inGates, 0.f));
 			}
+			float maxGateValue = hmax(maxGates);
 			if(gatesHigh && maxGateValue <= 0.1f){
 				gatesHigh = false;
+				outputsDirty = true;
 
 				//In record mode, advance step on gates going low
 				if(recording){
@@ -526,7 +1263,7 @@ struct ChordVault : Module {
 					//We have to do extra work here to only sort CVs with high gates	
 					sortAndClearCurrentCVs();
 
-					setVaultPos((vault_pos + 1) % VAULT_SIZE);
+					setVaultPos((vault_pos + 1) % vaultSize);
 
 					//Stop previewing when when moving to next step
 					stepSelect_previewGateTimer = 0;
@@ -536,77 +1273,858 @@ struct ChordVault : Module {
 
 				if(recording){
 					//On Gate high on this step, first clear all the gate values
-					//Clear next gates
-					for(int ci = 0; ci < CHANNEL_COUNT; ci++){
-						vault_gate[getVaultPos()][ci] = false;
+					//Clear next gates, only the float_4 blocks of the channels in use. Lanes past them are never played.
+					float* gates = vault_gate[getVaultPos()];
+					for(int ci = 0; ci < channels; ci += 4){
+						simd::float_4::zero().store(gates + ci);
+					}
+					invalidateOutCV(getVaultPos());
+				}
+			}
+		}
+
+		perfLap.lap(perf[PERF_GATES]);
+
+		sendChain();
+
+		//In a chain the step and clock come from the first ChordVault
+		bool stepClock = clockHigh;
+		if(chainIndex >= 0 && !recording){
+			ChainMessage* chainMessage = (ChainMessage*)leftExpander.consumerMessage;
+			bool first = chainIndex == 0;
+			if(first || chainMessage->chained){
+				if(!first){
+					//Followers have no clock of their own, the step gate timers measure the chain clock instead
+					if(clockCounter < INT_MAX) clockCounter++;
+					if(chainMessage->clockHigh && !chainClockHigh){
+						clockPeriod = clockCounter;
+						clockCounter = 0;
+					}
+					chainClockHigh = chainMessage->clockHigh;
+				}
+				int position = first ? chainPos : chainMessage->position - chainMessage->offset;
+				bool playing = position >= 0 && position < seqLength;
+				if(playing){
+					setVaultPos(seqStart + position);
+				}else{
+					//A step that is still timed doesn't carry over to the other ChordVaults' steps
+					stepGateTimed = false;
+					stepMuted = false;
+				}
+				bool gateHigh = (first ? clockHigh && !partialPlayClock : chainMessage->clockHigh) && playing;
+				if(gateHigh != chainGateHigh){
+					chainGateHigh = gateHigh;
+					outputsDirty = true;
+					//Each ChordVault of the chain plays the step gate and strum of its own step
+					if(gateHigh){
+						startStepGate();
+						startStrum(args.sampleRate);
 					}
 				}
+				stepClock = gateHigh;
 			}
 		}
 
-		bool outGateHigh = clockHigh;
+		processStrum();
+
+		bool outGateHigh = processStepGate(stepClock);
+		if(outGateHigh != stepGateHigh){
+			stepGateHigh = outGateHigh;
+			outputsDirty = true;
+		}
 		bool previewGateHigh = false;
+		bool previewGateEnding = false;
 
 		if(stepSelect_previewGateTimer > 0){
 			stepSelect_previewGateTimer --;
 			outGateHigh = true;
 			previewGateHigh = true;
+			previewGateEnding = stepSelect_previewGateTimer == 0;
 		}
 
 		if(!recording && playMode == GLIDE){
 			setVaultPos(getCV_vault_pos());
 		}
 
+		perfLap.lap(perf[PERF_STEP]);
+
 		//Input/Output
-		{
-			for(int ci = 0; ci < channels; ci++){
+		//Channels are handled 4 at a time. Lanes past `channels` are masked out of every vault write.
+		//Outside of recording with gates high the outputs only change on events that set outputsDirty,
+		//so steady-state samples skip this block entirely.
+		if(outputsDirty || previewGateEnding || (recording && gatesHigh)){
+			//Once the preview timer runs out the preview gate has to be dropped on the next sample
+			outputsDirty = previewGateEnding;
+			outputs[CV_OUT_OUTPUT].setChannels(activeChannels);
+			outputs[GATE_OUT_OUTPUT].setChannels(activeChannels);
+
+			float* cvs = vault_cv[getVaultPos()];
+			float* gates = vault_gate[getVaultPos()];
+			simd::float_4 gateOutLevel = outGateHigh ? 10.f : 0.f;
+			//Recording writes into the row below, so the transposed row is taken afterwards
+			if(recording) invalidateOutCV(getVaultPos());
+
+			for(int ci = 0; ci < channels; ci += 4){
+				simd::float_4 channelMask = getChannelMask(ci);
 				bool outputVaultValues = false;
 				if(recording){
-					float inCV = inputs[CV_IN_INPUT].getVoltage(ci);
-					float inGate = inputs[GATE_IN_INPUT].getVoltage(ci);
-					if(inGate >= 2.0f){
-						vault_cv[getVaultPos()][ci] = inCV;
-						vault_gate[getVaultPos()][ci] = true;
-					}
+					simd::float_4 inCV = inputs[CV_IN_INPUT].getVoltageSimd<simd::float_4>(ci);
+					simd::float_4 inGate = inputs[GATE_IN_INPUT].getVoltageSimd<simd::float_4>(ci);
+					simd::float_4 recordMask = channelMask & (inGate >= 2.f);
+					simd::ifelse(recordMask, inCV, simd::float_4::load(cvs + ci)).store(cvs + ci);
+					simd::ifelse(recordMask, 1.f, simd::float_4::load(gates + ci)).store(gates + ci);
+
 					//Since we don't record to the vault until the gates are up we need this extra case here
 					//If the gates are down (before the gates go up) we want to output the values that are form the inputs
 					if(gatesHigh){
-						outputs[CV_OUT_OUTPUT].setVoltage(inCV,ci);
-						outputs[GATE_OUT_OUTPUT].setVoltage(inGate,ci);
+						//Recording never glides, the played notes are passed through as they are
+						glideActive = false;
+						inCV.store(glideCV + ci);
+						inCV.store(glideTarget + ci);
+						outputs[CV_OUT_OUTPUT].setVoltageSimd(inCV,ci);
+						outputs[GATE_OUT_OUTPUT].setVoltageSimd(inGate,ci);
 					}else if(previewGateHigh){
 						//Otherwise if we are previewing a note from the knob, we want to play it out
 						outputVaultValues = true;
 					}else{
 						//Otherwise reset the gate, but let the CV retain its previous value
-						outputs[GATE_OUT_OUTPUT].setVoltage(0,ci);
+						outputs[GATE_OUT_OUTPUT].setVoltageSimd(simd::float_4::zero(),ci);
 					}	
 				}else if(partialPlayClock){
 					//Don't play anything on the first partial clock 
 					
 					//But do clear the gates
-					outputs[GATE_OUT_OUTPUT].setVoltage(0,ci);
+					outputs[GATE_OUT_OUTPUT].setVoltageSimd(simd::float_4::zero(),ci);
 				}else{
 					outputVaultValues = true;
 				}
 
 				if(outputVaultValues){
 					//Output Gate Value
-					bool gateValue = vault_gate[getVaultPos()][ci];
-					outputs[GATE_OUT_OUTPUT].setVoltage((outGateHigh && gateValue) ? 10.f : 0.f,ci);
+					//Voices of a strummed chord that haven't started yet are masked out, their CV changes once they start
+					simd::float_4 gateValue = simd::float_4::load(gates + ci);
+					if(!previewGateHigh) gateValue *= simd::float_4::load(strumMask + ci);
+					outputs[GATE_OUT_OUTPUT].setVoltageSimd(gateValue * gateOutLevel,ci);
 
 					//Output CV Value
-					//This check makes it so steps without a gate don't change CV and instead hold their previous value
-					if(gateValue){
-						outputs[CV_OUT_OUTPUT].setVoltage(vault_cv[getVaultPos()][ci],ci);
-					}					
+					//Steps without a gate don't change CV and instead hold their previous value
+					simd::float_4 prevTarget = simd::float_4::load(glideTarget + ci);
+					simd::float_4 target = simd::ifelse(gateValue > 0.f, simd::float_4::load(getOutCVs(getVaultPos()) + ci), prevTarget);
+					if(glideSamples >= 1.f){
+						//Only voices with a new target restart their glide, processGlide() writes the output
+						simd::float_4 speed = glideMode == GLIDE_CONSTANT_TIME
+							? simd::fabs(target - simd::float_4::load(glideCV + ci)) / glideSamples
+							: simd::float_4(1.f / glideSamples);
+						simd::ifelse(target != prevTarget, speed, simd::float_4::load(glideSpeed + ci)).store(glideSpeed + ci);
+						glideActive = true;
+					}else{
+						target.store(glideCV + ci);
+						outputs[CV_OUT_OUTPUT].setVoltageSimd(target,ci);
+					}
+					target.store(glideTarget + ci);
 				}			
 			}
 		}
+
+		processGlide();
+		perfLap.lap(perf[PERF_OUTPUTS]);
+
+		if(snapshotDivider.process()){
+			updateRollSnapshot();
+			perfLap.lap(perf[PERF_SNAPSHOT]);
+		}
+		perfLap.finish(perf[PERF_TOTAL]);
+	}
+
+	//Moves every voice toward its glide target, a linear slew 4 channels at a time.
+	//Costs nothing once all voices have arrived.
+	void processGlide(){
+		if(!glideActive) return;
+		int moving = 0;
+		for(int ci = 0; ci < channels; ci += 4){
+			simd::float_4 cv = simd::float_4::load(glideCV + ci);
+			simd::float_4 target = simd::float_4::load(glideTarget + ci);
+			simd::float_4 speed = simd::float_4::load(glideSpeed + ci);
+			simd::float_4 delta = target - cv;
+			cv = simd::ifelse(simd::fabs(delta) <= speed, target, cv + simd::clamp(delta, -speed, speed));
+			cv.store(glideCV + ci);
+			outputs[CV_OUT_OUTPUT].setVoltageSimd(cv,ci);
+			moving |= simd::movemask(cv != target);
+		}
+		glideActive = moving != 0;
+	}
+
+	//Called on the clock that starts a step. Rolls the step probability and sets up the gate timers.
+	void startStepGate(){
+		int step = getVaultPos();
+		//Steps that always play don't draw, so the random play modes see the same sequence as without probabilities
+		int probability = banks[bank]->probability[step];
+		stepMuted = probability < PROBABILITY_DEFAULT && uniform() * 100.f >= probability;
+		int ratchets = banks[bank]->ratchets[step];
+		int length = banks[bank]->gateLength[step];
+		//The timers need a measured clock period, until then the gate follows the clock
+		stepGateTimed = (ratchets > 1 || length > 0) && clockPeriod > 0;
+		if(stepGateTimed){
+			ratchetSamples = std::max(clockPeriod / ratchets, 1);
+			//Ratchets on a step that follows the clock play half length gates
+			gateSamples = clamp(ratchetSamples * (length > 0 ? length : 50) / 100, 1, ratchetSamples);
+			ratchetsLeft = ratchets;
+			ratchetTimer = ratchetSamples;
+			gateTimer = gateSamples;
+		}
+	}
+
+	//Schedules the voice onsets of the step that just started. Voices go up or down the channel order,
+	//which is lowest to highest note with the Sorted CV Record Order.
+	void startStrum(float sampleRate){
+		stopStrum();
+		if(strumMode == STRUM_OFF) return;
+
+		bool upwards = strumMode == STRUM_UP || (strumMode == STRUM_ALTERNATE && strumUpwards);
+		strumUpwards = !strumUpwards;
+		int voiceSamples = strumTime * sampleRate / 1000.f;
+		float jitterSamples = strumJitter * sampleRate / 1000.f;
+
+		//Onsets are kept in order with an insertion sort, jitter can swap neighboring voices
+		StrumEvent events [CHANNEL_COUNT];
+		int count = 0;
+		int step = getVaultPos();
+		for(int i = 0; i < channels; i++){
+			int ci = upwards ? i : channels - 1 - i;
+			if(vault_gate[step][ci] <= 0.f) continue;
+			strumMask[ci] = 0.f;
+			int jitter = jitterSamples > 0.f ? (int)(uniform(strumRng) * jitterSamples) : 0;
+			StrumEvent event = {count * voiceSamples + jitter, ci};
+			int ei = count++;
+			while(ei > 0 && events[ei - 1].delay > event.delay){
+				events[ei] = events[ei - 1];
+				ei--;
+			}
+			events[ei] = event;
+		}
+		for(int ei = 0; ei < count; ei++) strumEvents.push(events[ei]);
+	}
+
+	//Starts the voices whose onset has come
+	void processStrum(){
+		if(!strumPending && strumEvents.empty()) return;
+		while(strumPending || !strumEvents.empty()){
+			if(!strumPending){
+				strumNext = strumEvents.shift();
+				strumPending = true;
+			}
+			if(strumNext.delay > strumTimer) break;
+			strumMask[strumNext.channel] = 1.f;
+			strumPending = false;
+			outputsDirty = true;
+		}
+		strumTimer++;
+	}
+
+	void stopStrum(){
+		strumEvents.clear();
+		strumPending = false;
+		strumTimer = 0;
+		for(int ci = 0; ci < CHANNEL_COUNT; ci++) strumMask[ci] = 1.f;
+	}
+
+	//Gate of the current step for this sample. With the default step settings it is the clock, which in a chain is
+	//the clock of the first ChordVault while this one plays.
+	bool processStepGate(bool clock){
+		if(recording) return clock;
+		if(stepMuted) return false;
+		if(!stepGateTimed) return clock;
+
+		if(ratchetTimer == 0 && ratchetsLeft > 1){
+			ratchetsLeft--;
+			ratchetTimer = ratchetSamples;
+			gateTimer = gateSamples;
+		}
+		bool high = gateTimer > 0;
+		if(ratchetTimer > 0) ratchetTimer--;
+		if(gateTimer > 0) gateTimer--;
+		return high;
+	}
+
+	bool isOutputStale(int outputId){
+		return outputs[outputId].isConnected() && outputs[outputId].getChannels() != activeChannels;
+	}
+
+	//Returns a mask with the lanes for channels [ci, ci + 4) set when they are below `channels`
+	inline simd::float_4 getChannelMask(int ci){
+		return simd::float_4(ci, ci + 1, ci + 2, ci + 3) < (float)channels;
+	}
+
+	void setSeed(uint64_t newSeed){
+		seed = newSeed;
+		//The second word is never zero so the generator can't get stuck on an all zero state
+		rng.seed(seed, seed ^ 0x9e3779b97f4a7c15ULL);
+		strumRng.seed(~seed, seed ^ 0x5851f42d4c957f2dULL);
+	}
+
+	//Uniform float in [0, 1) from the module's own generator
+	float uniform(){
+		return uniform(rng);
+	}
+
+	static float uniform(random::Xoroshiro128Plus& generator){
+		return (generator() >> 40) * 5.9604645e-08f;
+	}
+
+	//Called from the UI thread. If the queue is full the change is dropped and false is returned.
+	bool pushCommand(CommandId id, int value, int step = 0, int target = 0){
+		if(commands.full()) return false;
+		commands.push({id, value, step, target});
+		return true;
+	}
+
+	void processCommands(){
+		while(!commands.empty()){
+			Command command = commands.shift();
+			switch(command.id){
+				case SET_RECORDING_CMD:
+					recording = command.value;
+					updateRecordModeLights();
+					outputsDirty = true;
+					break;
+				case SET_START_STEP_MODE_CMD:
+					startStepMode = command.value;
+					if(!startStepMode) seqStart = 0; //When leaving the mode reset the sequence offset/start back to 0
+					break;
+				case SET_PLAY_MODE_CMD:
+					playMode = (PlayMode)command.value;
+					updatePlayModeLights();
+					break;
+				case SET_BANK_CMD:
+					selectedBank = command.value;
+					break;
+				case SET_CHANNELS_CMD:
+					channels = command.value;
+					updateActiveChannels();
+					break;
+				case SET_DYNAMIC_CHANNELS_CMD:
+					dynamicChannels = command.value;
+					break;
+				case SET_SKIP_PARTIAL_CLOCK_CMD:
+					skipPartialClock = command.value;
+					break;
+				case SET_VAULT_SIZE_CMD:
+					setVaultSize(command.value);
+					break;
+				case SET_CONTROL_RATE_CMD:
+					setControlRate(command.value);
+					break;
+				case SET_CV_RANGE_CMD:
+					cvRange = (CVRange)command.value;
+					break;
+				case SET_CV_ORDER_CMD:
+					cvOrder = (CVOrder)command.value;
+					break;
+				case SHIFT_NOTES_CMD:
+					shiftNotes(command.value);
+					break;
+				case SET_RESEED_ON_RESET_CMD:
+					reseedOnReset = command.value;
+					break;
+				case NEW_SEED_CMD:
+					setSeed(random::u64());
+					break;
+				case SET_STEP_WEIGHT_CMD:
+					banks[bank]->weight[command.step] = command.value;
+					aliasDirty = true;
+					break;
+				case RESET_STEP_WEIGHTS_CMD:
+					memset(banks[bank]->weight, STEP_WEIGHT_DEFAULT, sizeof banks[bank]->weight);
+					aliasDirty = true;
+					break;
+				case SET_MARKOV_CMD:
+					markov[command.step].set(command.target, clamp(command.value, 0, STEP_WEIGHT_MAX));
+					break;
+				case CLEAR_MARKOV_STEP_CMD:
+					markov[command.step].count = 0;
+					break;
+				case CLEAR_MARKOV_CMD:
+					memset(markov, 0, sizeof markov);
+					break;
+				case LEARN_MARKOV_CMD:
+					learnMarkov();
+					break;
+				case SET_TRANSPOSE_CMD:
+					transpose = command.value;
+					invalidateOutCVs();
+					break;
+				case SET_QUANTIZE_RECORD_CMD:
+					quantizeRecord = command.value;
+					break;
+				case SET_QUANTIZE_OUTPUT_CMD:
+					quantizeOutput = command.value;
+					invalidateOutCVs();
+					break;
+				case SET_SCALE_ROOT_CMD:
+					scaleRoot = command.value;
+					invalidateOutCVs();
+					break;
+				case SET_SCALE_CMD:
+					scale = command.value;
+					invalidateOutCVs();
+					break;
+				case SET_TUNING_CMD:
+					tuning = stagedTuning;
+					stagedTuningPending = false;
+					scale = Scale_MAX;
+					invalidateOutCVs();
+					break;
+				case SET_GATE_LENGTH_CMD:
+					banks[bank]->gateLength[command.step] = command.value;
+					break;
+				case SET_RATCHETS_CMD:
+					banks[bank]->ratchets[command.step] = command.value;
+					break;
+				case SET_PROBABILITY_CMD:
+					banks[bank]->probability[command.step] = command.value;
+					break;
+				case RESET_STEP_GATES_CMD:
+					memset(banks[bank]->gateLength, 0, sizeof banks[bank]->gateLength);
+					memset(banks[bank]->ratchets, 1, sizeof banks[bank]->ratchets);
+					memset(banks[bank]->probability, PROBABILITY_DEFAULT, sizeof banks[bank]->probability);
+					break;
+				case SET_STRUM_MODE_CMD:
+					strumMode = (StrumMode)command.value;
+					break;
+				case SET_STRUM_TIME_CMD:
+					strumTime = command.value;
+					break;
+				case SET_STRUM_JITTER_CMD:
+					strumJitter = command.value;
+					break;
+				case SET_GLIDE_MODE_CMD:
+					glideMode = (GlideMode)command.value;
+					break;
+				case SET_PERF_CMD:
+					perfEnabled = command.value;
+					break;
+				case RESET_PERF_CMD:
+					for(int pi = 0; pi < PerfSection_MAX; pi++) perf[pi].clear();
+					break;
+				case IMPORT_MIDI_CMD:{
+					//Swapped in by pointer like a bank switch, only the step settings of the bank are carried over
+					VaultBank* imported = stagedBank;
+					stagedBank = banks[bank];
+					banks[bank] = imported;
+					memcpy(imported->weight, stagedBank->weight, sizeof imported->weight);
+					memcpy(imported->gateLength, stagedBank->gateLength, sizeof imported->gateLength);
+					memcpy(imported->ratchets, stagedBank->ratchets, sizeof imported->ratchets);
+					memcpy(imported->probability, stagedBank->probability, sizeof imported->probability);
+					params[LENGTH_KNOB_PARAM].setValue(stagedSteps);
+					stagedBankPending = false;
+					setBank(bank);
+					setVaultPos(0);
+					}break;
+				case APPLY_TRANSPOSE_CMD:
+					//Write the transpose into the recorded notes
+					shiftNotes(transpose);
+					transpose = 0;
+					invalidateOutCVs();
+					break;
+			}
+		}
+	}
+
+	void onExpanderChange(const ExpanderChangeEvent& e) override {
+		//Whatever the previous neighbor sent is stale, empty messages mean there is no chain on that side
+		if(e.side == 0){
+			leftLinked = isChainModule(leftExpander.module);
+			memset(chainMessages, 0, sizeof chainMessages);
+		}else{
+			rightLinked = isChainModule(rightExpander.module);
+			memset(expanderMessages, 0, sizeof expanderMessages);
+		}
+	}
+
+	//Finds this ChordVault's place in a chain from the last messages of its neighbors
+	void updateChain(){
+		ChainMessage* message = (ChainMessage*)leftExpander.consumerMessage;
+		ChainReport* report = &((ExpanderMessage*)rightExpander.consumerMessage)->chain;
+		int index = message->index;
+		if(index >= CHAIN_MAX || (index == 0 && report->vaults == 0)) index = -1;
+		if(index != chainIndex){
+			chainIndex = index;
+			outputsDirty = true;
+		}
+	}
+
+	void nextChainPosition(){
+		if(chainLength <= 1){
+			chainPos = 0;
+			return;
+		}
+		switch(playMode){
+			case BACKWARD:
+				chainPos = (chainPos + chainLength - 1) % chainLength;
+				break;
+			case RANDOM:{
+				//Select a new position that isn't the current one
+				int newPos = (int)std::floor(uniform() * (chainLength - 1));
+				if(newPos >= chainPos) newPos++;
+				chainPos = newPos;
+				}break;
+			default:
+				chainPos = (chainPos + 1) % chainLength;
+				break;
+		}
+	}
+
+	//Passes the chain on to the direct neighbors. The first ChordVault starts the message to the right with its position
+	//in the combined sequence, every following one adds its own length to the offset. The report to the left adds this
+	//ChordVault to the ones after it.
+	//Each hop takes one sample, so the n-th ChordVault after the first one switches steps n samples after it. Switching
+	//them all on the same sample would mean holding back the first ChordVault's own clock by the length of the chain.
+	void sendChain(){
+		ChainMessage* message = (ChainMessage*)leftExpander.consumerMessage;
+		ChainReport* report = &((ExpanderMessage*)rightExpander.consumerMessage)->chain;
+		//The ChordVault after the last possible member isn't part of the chain
+		bool last = message->index >= CHAIN_MAX - 1;
+		if(chainIndex == 0){
+			chainLength = seqLength + report->length;
+			if(chainPos >= chainLength) chainPos = 0;
+		}
+
+		if(rightLinked){
+			ChainMessage* out = (ChainMessage*)rightExpander.module->leftExpander.producerMessage;
+			out->index = std::min(message->index + 1, CHAIN_MAX);
+			if(chainIndex == 0){
+				out->chained = !recording; //The chain pauses while the first ChordVault records
+				out->position = chainPos;
+				out->offset = seqLength;
+				out->clockHigh = clockHigh && !partialPlayClock;
+			}else{
+				out->chained = chainIndex > 0 && message->chained;
+				out->position = message->position;
+				out->offset = message->offset + seqLength;
+				out->clockHigh = message->clockHigh;
+			}
+			rightExpander.module->leftExpander.requestMessageFlip();
+		}
+
+		if(leftLinked){
+			ExpanderMessage* out = (ExpanderMessage*)leftExpander.module->rightExpander.producerMessage;
+			out->expander = false;
+			if(message->index >= CHAIN_MAX){
+				out->chain.vaults = 0;
+				out->chain.length = 0;
+			}else{
+				out->chain.vaults = 1 + (last ? 0 : report->vaults);
+				out->chain.length = seqLength + (last ? 0 : report->length);
+			}
+			leftExpander.module->rightExpander.requestMessageFlip();
+		}
+	}
+
+	//The piano roll sits to the right of this ChordVault or to the right of its expander
+	ChordVaultRoll* getRoll(){
+		Module* roll = rightExpander.module;
+		if(roll && roll->model == modelChordVaultExpander) roll = roll->rightExpander.module;
+		if(roll && roll->model == modelChordVaultRoll) return static_cast<ChordVaultRoll*>(roll);
+		return NULL;
+	}
+
+	//Publishes a new snapshot to the piano roll when anything it shows has changed.
+	//The UI thread only ever reads the snapshots, never the vault itself.
+	void updateRollSnapshot(){
+		ChordVaultRoll* roll = getRoll();
+		if(roll != snapshotRoll){
+			snapshotRoll = roll;
+			snapshotDirty = true;
+		}
+		if(!roll) return;
+
+		int position = !recording && partialPlayClock ? -1 : getVaultPos();
+		int upcoming [SNAPSHOT_LOOKAHEAD];
+		int upcomingCount = getUpcomingSteps(upcoming, SNAPSHOT_LOOKAHEAD);
+		for(int i = 0; i < upcomingCount; i++) upcoming[i] = mod_0_max(upcoming[i], vaultSize);
+		const VaultSnapshot* last = roll->snapshots.getLast();
+		if(!snapshotDirty && last && last->position == position && last->seqStart == seqStart && last->seqLength == seqLength
+			&& last->vaultSize == vaultSize && last->channels == channels && last->upcomingCount == upcomingCount
+			&& std::equal(upcoming, upcoming + upcomingCount, last->upcoming)) return;
+		snapshotDirty = false;
+
+		VaultSnapshot* snapshot = roll->snapshots.getBack();
+		snapshot->version = ++snapshotVersion;
+		snapshot->vaultSize = vaultSize;
+		snapshot->seqStart = seqStart;
+		snapshot->seqLength = seqLength;
+		snapshot->position = position;
+		snapshot->channels = channels;
+		snapshot->upcomingCount = upcomingCount;
+		std::copy(upcoming, upcoming + upcomingCount, snapshot->upcoming);
+		for(int si = 0; si < vaultSize; si++){
+			memcpy(snapshot->cv[si], getOutCVs(si), sizeof snapshot->cv[si]);
+			uint16_t gates = 0;
+			for(int ci = 0; ci < CHANNEL_COUNT; ci++){
+				if(vault_gate[si][ci] > 0.f) gates |= 1 << ci;
+			}
+			snapshot->gates[si] = gates;
+		}
+		roll->snapshots.publish();
+	}
+
+	//Inputs of the expander to the right, NULL without one. They are read from the expander message, never from the
+	//expander module itself, which may be processed on another thread.
+	ExpanderMessage* getExpanderMessage(){
+		ExpanderMessage* message = (ExpanderMessage*)rightExpander.consumerMessage;
+		return message->expander ? message : NULL;
+	}
+
+	//The bank CV on the expander takes priority over the bank selected in the context menu
+	int getTargetBank(){
+		ExpanderMessage* expander = getExpanderMessage();
+		if(expander && expander->bankConnected){
+			//0-10V covers all banks
+			int cvBank = (int)(expander->bankCV / 10.01f * BANK_COUNT);
+			return clamp(cvBank, 0, BANK_COUNT - 1);
+		}
+		return selectedBank;
+	}
+
+	void setBank(int new_bank){
+		bank = new_bank;
+		vault_cv = banks[bank]->cv;
+		vault_gate = banks[bank]->gate;
+		aliasDirty = true;
+		invalidateOutCVs();
+		updateActiveChannels();
+	}
+
+	//Marks every row of outCV as stale
+	void invalidateOutCVs(){
+		snapshotDirty = true;
+		outCVVersion++;
+		if(outCVVersion == 0) outCVVersion = 1; //0 is reserved for single stale rows
+		outputsDirty = true;
+	}
+
+	void invalidateOutCV(int step){
+		snapshotDirty = true;
+		outCVRowVersion[step] = 0;
+	}
+
+	float* getOutCVs(int step){
+		if(outCVRowVersion[step] != outCVVersion){
+			simd::float_4 offset = transpose / 12.f + transposeCV;
+			for(int ci = 0; ci < CHANNEL_COUNT; ci += 4){
+				(simd::float_4::load(vault_cv[step] + ci) + offset).store(outCV[step] + ci);
+			}
+			//All lanes, a cached row must stay valid when the channel count grows
+			if(quantizeOutput){
+				for(int ci = 0; ci < CHANNEL_COUNT; ci++) outCV[step][ci] = quantizeCV(outCV[step][ci]);
+			}
+			outCVRowVersion[step] = outCVVersion;
+		}
+		return outCV[step];
+	}
+
+	float quantizeCV(float cv){
+		if(scale == Scale_MAX){
+			if(tuning.mapped) return tuning.quantize(cv);
+			//Unmapped tunings start on the root note
+			float rootCV = scaleRoot / 12.f;
+			return tuning.quantize(cv - rootCV) + rootCV;
+		}
+		return quantizeToScale(SCALES[scale], scaleRoot, cv);
+	}
+
+	//Called from the UI thread. Writes the chords into consecutive steps of the staging bank, with the current number
+	//of channels and CV Record Order, and hands them to the engine thread to replace the active bank.
+	bool stageMidiImport(const MidiChords& chords, std::string& error){
+		if(stagedBankPending){
+			error = "The previous import hasn't been applied yet";
+			return false;
+		}
+		stagedBank->clear();
+		stagedSteps = std::min((int)chords.size(), vaultSize);
+		for(int si = 0; si < stagedSteps; si++){
+			std::vector<int> notes(chords[si].begin(), chords[si].begin() + std::min((int)chords[si].size(), channels));
+			if(cvOrder == CVOrder::Sorted) std::sort(notes.begin(), notes.end());
+			for(size_t ci = 0; ci < notes.size(); ci++){
+				stagedBank->cv[si][ci] = (notes[ci] - 60) / 12.f;
+				stagedBank->gate[si][ci] = 1.f;
+			}
+		}
+		stagedBankPending = true;
+		if(!pushCommand(IMPORT_MIDI_CMD, 0)){
+			stagedBankPending = false;
+			error = "The module is busy, try again";
+			return false;
+		}
+		return true;
+	}
+
+	//Called from the UI thread. Notes of each step of the sequence, 60 is C4 (0V)
+	MidiChords getSequenceChords(){
+		MidiChords chords(seqLength);
+		for(int i = 0; i < seqLength; i++){
+			int step = (seqStart + i) % vaultSize;
+			for(int ci = 0; ci < channels; ci++){
+				if(vault_gate[step][ci] > 0.f) chords[i].push_back(60 + (int)std::round(vault_cv[step][ci] * 12.f));
+			}
+		}
+		return chords;
+	}
+
+	//Called from the UI thread. Parses the tuning into the staging table and hands it to the engine thread.
+	bool loadTuning(const std::string& scl, const std::string& kbm, std::string& error){
+		if(stagedTuningPending){
+			error = "The previous tuning hasn't been applied yet";
+			return false;
+		}
+		if(!parseScala(scl, kbm, stagedTuning, error)) return false;
+		stagedTuningPending = true;
+		if(!pushCommand(SET_TUNING_CMD, 0)){
+			stagedTuningPending = false;
+			error = "The module is busy, try again";
+			return false;
+		}
+		sclText = scl;
+		kbmText = kbm;
+		return true;
+	}
+
+	//Vose's alias method. Afterwards a step is picked with a single random value in O(1), see getWeightedStep()
+	void buildAliasTable(){
+		aliasDirty = false;
+		aliasStart = seqStart;
+		aliasLength = seqLength;
+
+		int n = seqLength;
+		float scaled [VAULT_SIZE_MAX];
+		int total = 0;
+		for(int i = 0; i < n; i++) total += banks[bank]->weight[(seqStart + i) % vaultSize];
+		for(int i = 0; i < n; i++){
+			//If every weight is 0 fall back to picking all steps equally
+			scaled[i] = total > 0 ? banks[bank]->weight[(seqStart + i) % vaultSize] * n / (float)total : 1.f;
+		}
+
+		int small [VAULT_SIZE_MAX];
+		int large [VAULT_SIZE_MAX];
+		int smallCount = 0;
+		int largeCount = 0;
+		for(int i = 0; i < n; i++){
+			if(scaled[i] < 1.f) small[smallCount++] = i;
+			else large[largeCount++] = i;
+		}
+		while(smallCount > 0 && largeCount > 0){
+			int s = small[--smallCount];
+			int l = large[--largeCount];
+			aliasProb[s] = scaled[s];
+			aliasIndex[s] = l;
+			scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+			if(scaled[l] < 1.f) small[smallCount++] = l;
+			else large[largeCount++] = l;
+		}
+		//Whatever is left over is 1 up to rounding errors
+		while(largeCount > 0){
+			int l = large[--largeCount];
+			aliasProb[l] = 1.f;
+			aliasIndex[l] = l;
+		}
+		while(smallCount > 0){
+			int s = small[--smallCount];
+			aliasProb[s] = 1.f;
+			aliasIndex[s] = s;
+		}
+	}
+
+	//Only the channels in use are compared, lanes past them can hold voices of an earlier recording
+	bool isSameChord(int a, int b){
+		for(int ci = 0; ci < channels; ci++){
+			if(vault_gate[a][ci] != vault_gate[b][ci]) return false;
+			if(vault_gate[a][ci] > 0.f && vault_cv[a][ci] != vault_cv[b][ci]) return false;
+		}
+		return true;
+	}
+
+	//Rebuild the transitions of the sequence steps from the recorded chords. Every time a chord is followed by another chord
+	//in the sequence, all steps holding the first chord get a transition to the step after it. Repeated chords count up
+	//the weight, so C F C G C F gives C -> F twice as often as C -> G. When a chord is followed by more than
+	//MARKOV_TARGETS different chords the most frequent ones are kept.
+	void learnMarkov(){
+		//First step of the sequence holding the same chord as each sequence step, as a sequence offset
+		int first [VAULT_SIZE_MAX];
+		for(int i = 0; i < seqLength; i++){
+			first[i] = i;
+			for(int k = 0; k < i; k++){
+				if(first[k] == k && isSameChord((seqStart + k) % vaultSize, (seqStart + i) % vaultSize)){
+					first[i] = k;
+					break;
+				}
+			}
+		}
+		for(int i = 0; i < seqLength; i++){
+			//Transitions counted by the sequence offset of the next chord
+			int counts [VAULT_SIZE_MAX] = {};
+			for(int j = 0; j < seqLength; j++){
+				if(first[j] == first[i]) counts[first[(j + 1) % seqLength]]++;
+			}
+
+			//The most frequent targets, the earlier step wins a tie
+			bool kept [VAULT_SIZE_MAX] = {};
+			int maxCount = 0;
+			for(int ti = 0; ti < MARKOV_TARGETS; ti++){
+				int best = -1;
+				for(int k = 0; k < seqLength; k++){
+					if(counts[k] > 0 && !kept[k] && (best < 0 || counts[k] > counts[best])) best = k;
+				}
+				if(best < 0) break;
+				kept[best] = true;
+				maxCount = std::max(maxCount, counts[best]);
+			}
+
+			//Counts above the weight range are scaled down, keeping their ratios
+			MarkovRow& row = markov[(seqStart + i) % vaultSize];
+			row.count = 0;
+			for(int k = 0; k < seqLength; k++){
+				if(!kept[k]) continue;
+				int weight = counts[k];
+				if(maxCount > MARKOV_WEIGHT_MAX) weight = std::max((int)std::round(weight * (float)MARKOV_WEIGHT_MAX / maxCount), 1);
+				row.target[row.count] = (seqStart + k) % vaultSize;
+				row.weight[row.count] = weight;
+				row.count++;
+			}
+			row.update();
+		}
+	}
+
+	//Steps without transitions, or transitions leaving the sequence, just play the next step
+	int getMarkovStep(){
+		MarkovRow& row = markov[getVaultPos()];
+		int next = vault_pos + 1;
+		if(row.count > 0){
+			float r = uniform();
+			int ti = 0;
+			while(ti < row.count - 1 && r >= row.cumulative[ti]) ti++;
+			int offset = mod_0_max(row.target[ti] - seqStart, vaultSize);
+			if(offset < seqLength) next = seqStart + offset;
+		}
+		if(next >= seqLength+seqStart) next = seqStart;
+		return next;
+	}
+
+	int getWeightedStep(){
+		if(aliasDirty || aliasStart != seqStart || aliasLength != seqLength) buildAliasTable();
+		float r = uniform() * seqLength;
+		int i = std::min((int)r, seqLength - 1);
+		return seqStart + (r - i < aliasProb[i] ? i : aliasIndex[i]);
+	}
+
+	void setControlRate(int rate){
+		controlRate = clamp(rate, 1, ControlRate_OPTIONS[ControlRate_MAX - 1]);
+		controlDivider.setDivision(controlRate);
 	}
 
 	void setVaultPos(int new_pos){
 		if(vault_pos == new_pos) return;
 		vault_pos = new_pos;
+		outputsDirty = true;
 		if(startStepMode && !recording){
 			//Do Nothing
 		}else{
@@ -626,16 +2144,35 @@ struct ChordVault : Module {
 		}else{
 			activeChannels = channels;
 		}
+		outputsDirty = true;
 	}
 
 	inline int getVaultPos(){
-		return vault_pos % VAULT_SIZE;
+		return vault_pos % vaultSize;
+	}
+
+	void setVaultSize(int size){
+		vaultSize = clamp(size, VAULT_SIZE_DEFAULT, VAULT_SIZE_MAX);
+
+		//The knob ranges follow the vault size
+		ParamQuantity* stepQuantity = getParamQuantity(STEP_KNOB_PARAM);
+		stepQuantity->maxValue = vaultSize - 1;
+		ParamQuantity* lengthQuantity = getParamQuantity(LENGTH_KNOB_PARAM);
+		lengthQuantity->maxValue = vaultSize;
+		if(params[LENGTH_KNOB_PARAM].getValue() > vaultSize) params[LENGTH_KNOB_PARAM].setValue(vaultSize);
+		seqLength = std::min(seqLength, vaultSize);
+		seqStart = std::min(seqStart, vaultSize - 1);
+		aliasDirty = true; //A window that wraps around the end covers other steps now
+
+		setVaultPos(getVaultPos());
+		if(params[STEP_KNOB_PARAM].getValue() > vaultSize - 1) params[STEP_KNOB_PARAM].setValue(getVaultPos());
 	}
 
 	void setStartingVaultPosition(){
 		switch(playMode){
 			case SKIP:
 			case PING_PONG:
+			case MARKOV:
 			case FORWARD:{
 				setVaultPos(seqStart);
 				}break;
@@ -644,6 +2181,7 @@ struct ChordVault : Module {
 				setVaultPos(seqStart+seqLength-1);
 				}break;
 
+			case WEIGHTED:
 			case RANDOM:{
 				nextVaultPosition();
 				}break;
@@ -661,17 +2199,103 @@ struct ChordVault : Module {
 		}
 	}
 
+	void updateOrder(){
+		if(orderLength > 0 && orderMode == playMode && orderStart == seqStart && orderSeqLength == seqLength) return;
+		orderMode = playMode;
+		orderStart = seqStart;
+		orderSeqLength = seqLength;
+		orderLength = 0;
+		if(playMode == BACKWARD){
+			for(int i = seqLength - 1; i >= 0; i--) order[orderLength++] = seqStart + i;
+		}else{
+			for(int i = 0; i < seqLength; i++) order[orderLength++] = seqStart + i;
+			//Ping pong comes back down without repeating the end steps
+			if(playMode == PING_PONG){
+				for(int i = seqLength - 2; i > 0; i--) order[orderLength++] = seqStart + i;
+			}
+		}
+		orderIndex = 0;
+	}
+
+	//Entry of the current step in the order table, -1 when it is outside of the SEQ window
+	int findInOrder(){
+		updateOrder();
+		//Ping pong has most steps twice, pingPongDir tells on which way the step is
+		if(order[orderIndex] == vault_pos && (playMode != PING_PONG || pingPongDir == (orderIndex > 0 && orderIndex < seqLength))) return orderIndex;
+		//After a reset, the step knob or a window change the position has to be searched
+		int from = playMode == PING_PONG && !pingPongDir ? seqLength - 1 : 0;
+		for(int i = 0; i < orderLength; i++){
+			int index = (from + i) % orderLength;
+			if(order[index] == vault_pos) return index;
+		}
+		return -1;
+	}
+
+	int getNextInOrder(){
+		int index = findInOrder();
+		if(index < 0){
+			//Outside of the window the position walks toward it one step at a time
+			switch(playMode){
+				case FORWARD:
+					return vault_pos + 1 < seqStart + seqLength ? vault_pos + 1 : seqStart;
+				case BACKWARD:
+					return vault_pos - 1 >= seqStart ? vault_pos - 1 : seqStart + seqLength - 1;
+				default:
+					if(seqLength == 1) return seqStart;
+					if(pingPongDir && vault_pos + 1 >= seqStart + seqLength){
+						pingPongDir = false;
+						return seqStart + seqLength - 2;
+					}
+					if(!pingPongDir && vault_pos - 1 < seqStart){
+						pingPongDir = true;
+						return seqStart + 1;
+					}
+					return pingPongDir ? vault_pos + 1 : vault_pos - 1;
+			}
+		}
+		orderIndex = (index + 1) % orderLength;
+		if(playMode == PING_PONG && orderLength > 1) pingPongDir = orderIndex > 0 && orderIndex < seqLength;
+		return order[orderIndex];
+	}
+
+	//Fills steps with up to count upcoming steps, in the order they will play, without advancing.
+	//Returns how many are known: only the table driven modes (and Shuffle until the end of its round) can look ahead,
+	//and only while playing from the SEQ window of a ChordVault that isn't chained.
+	int getUpcomingSteps(int* steps, int count){
+		if(recording || partialPlayClock || chainIndex >= 0) return 0;
+		int known = 0;
+		switch(playMode){
+			case FORWARD:
+			case BACKWARD:
+			case PING_PONG:{
+				int index = findInOrder();
+				if(index < 0) return 0;
+				for(; known < count; known++){
+					index = (index + 1) % orderLength;
+					steps[known] = order[index];
+				}
+				}break;
+
+			case SHUFFLE:{
+				//The round is reshuffled once it wraps back to index 0
+				if(shuffle_index == 0) return 0;
+				for(int index = shuffle_index + 1; known < count && index <= seqLength; known++, index++){
+					steps[known] = seqStart + shuffle_arr[index % seqLength];
+				}
+				}break;
+
+			default:
+				break;
+		}
+		return known;
+	}
+
 	void nextVaultPosition(){
 		switch(playMode){
 			//Normal Modes
-			case FORWARD:{
-				setVaultPos(vault_pos+1);
-				if(vault_pos >= seqLength+seqStart) setVaultPos(seqStart);
-				}break;
-		
+			case FORWARD:
 			case BACKWARD:{
-				setVaultPos(vault_pos-1);
-				if(vault_pos < seqStart) setVaultPos(seqLength+seqStart-1);
+				setVaultPos(getNextInOrder());
 				}break;
 
 			case RANDOM:{
@@ -679,7 +2303,7 @@ struct ChordVault : Module {
 					setVaultPos(seqStart);
 				}else{
 					//Select a new position that isn't the current one
-					int newPos = seqStart + (int)std::floor(rack::random::uniform() * (seqLength - 1));
+					int newPos = seqStart + (int)std::floor(uniform() * (seqLength - 1));
 					if(newPos >= vault_pos) newPos++;
 					setVaultPos(newPos);
 				}
@@ -694,7 +2318,7 @@ struct ChordVault : Module {
 			case SKIP:{
 				//Chance of skipping a Chord, 20% by default but can be set by the CV_IN_INPUT
 				int newPos = vault_pos;
-				if(rack::random::uniform() < inputs[STEP_CV_INPUT].getNormalVoltage(2.f) / 10.f){
+				if(uniform() < inputs[STEP_CV_INPUT].getNormalVoltage(2.f) / 10.f){
 					newPos += 2;
 				}else{
 					newPos += 1;
@@ -704,32 +2328,16 @@ struct ChordVault : Module {
 				}break;
 
 			case PING_PONG:{
-				if(seqLength == 1){
-					setVaultPos(seqStart);
-				}else{
-					if(pingPongDir){
-						setVaultPos(vault_pos+1);
-						if(vault_pos >= seqLength+seqStart){
-							setVaultPos(seqLength-2+seqStart);
-							pingPongDir = false;
-						}
-					}else{
-						setVaultPos(vault_pos-1);
-						if(vault_pos < seqStart){
-							setVaultPos(seqStart+1);
-							pingPongDir = true;
-						}
-					}
-				}
+				setVaultPos(getNextInOrder());
 				}break;
 
 			case SHUFFLE:{
 				if(shuffle_index == 0){
-					for(int i = 0; i < VAULT_SIZE; i++){
+					for(int i = 0; i < seqLength; i++){
 						shuffle_arr[i] = i;
 					}
 					for(int i = 0; i < seqLength; i++){
-						int d = (int)std::floor(rack::random::uniform() * i);
+						int d = (int)std::floor(uniform() * i);
 						//Swap shuffle_arr[i] & shuffle_arr[d]
 						int v = shuffle_arr[i];
 						shuffle_arr[i] = shuffle_arr[d];
@@ -740,6 +2348,15 @@ struct ChordVault : Module {
 				if(shuffle_index >= seqLength) shuffle_index = 0;
 				setVaultPos(seqStart+shuffle_arr[shuffle_index]);
 				}break;
+
+			//Menu only Modes
+			case WEIGHTED:{
+				setVaultPos(getWeightedStep());
+				}break;
+
+			case MARKOV:{
+				setVaultPos(getMarkovStep());
+				}break;
 		}		
 	}
 
@@ -753,10 +2370,10 @@ struct ChordVault : Module {
 	int getSeqStartPos(bool includeCV){
 		int newPos = params[STEP_KNOB_PARAM].getValue();
 		if(includeCV){
-			newPos += getCVInputValue(VAULT_SIZE);
+			newPos += getCVInputValue(vaultSize);
 		}
-		while(newPos < 0) newPos += VAULT_SIZE;
-		while(newPos >= VAULT_SIZE) newPos -= VAULT_SIZE; 
+		while(newPos < 0) newPos += vaultSize;
+		while(newPos >= vaultSize) newPos -= vaultSize; 
 		return newPos;
 	}
 
@@ -804,24 +2421,26 @@ struct ChordVault : Module {
 			//In glide mode we will hold the same random value until the raw note changes
 			if(raw_note != prev_raw_note){
 				prev_raw_note = raw_note;
-				prev_raw_note_rnd = rack::random::uniform();
+				prev_raw_note_rnd = uniform();
 			}
 			return prev_raw_note_rnd;
 		}else{
 			//In every other mode we only check when the clock hits so we will just make a new random value every time
-			return rack::random::uniform();
+			return uniform();
 		}
 	}
 
 	void updatePlayModeLights(){
-		lights[PLAY_FORWARD_LIGHT + 0].setBrightness(playMode == FORWARD ? 1 : 0);
-		lights[PLAY_FORWARD_LIGHT + 1].setBrightness(playMode == SKIP ? 1 : 0);
+		//MARKOV lights both colors
+		lights[PLAY_FORWARD_LIGHT + 0].setBrightness(playMode == FORWARD || playMode == MARKOV ? 1 : 0);
+		lights[PLAY_FORWARD_LIGHT + 1].setBrightness(playMode == SKIP || playMode == MARKOV ? 1 : 0);
 
 		lights[PLAY_BACKWARD_LIGHT + 0].setBrightness(playMode == BACKWARD ? 1 : 0);
 		lights[PLAY_BACKWARD_LIGHT + 1].setBrightness(playMode == PING_PONG ? 1 : 0);
 
-		lights[PLAY_RANDOM_LIGHT + 0].setBrightness(playMode == RANDOM ? 1 : 0);
-		lights[PLAY_RANDOM_LIGHT + 1].setBrightness(playMode == SHUFFLE ? 1 : 0);
+		//WEIGHTED lights both colors
+		lights[PLAY_RANDOM_LIGHT + 0].setBrightness(playMode == RANDOM || playMode == WEIGHTED ? 1 : 0);
+		lights[PLAY_RANDOM_LIGHT + 1].setBrightness(playMode == SHUFFLE || playMode == WEIGHTED ? 1 : 0);
 
 		lights[PLAY_CV_LIGHT + 0].setBrightness(playMode == CV ? 1 : 0);
 		lights[PLAY_CV_LIGHT + 1].setBrightness(playMode == GLIDE ? 1 : 0);
@@ -833,13 +2452,20 @@ struct ChordVault : Module {
 	}
 
 	void sortAndClearCurrentCVs(){
+		auto cvs = vault_cv[getVaultPos()];
+		auto gates = vault_gate[getVaultPos()];
+
+		if(quantizeRecord){
+			for(int ci = 0; ci < channels; ci++){
+				if(gates[ci]) cvs[ci] = quantizeCV(cvs[ci]);
+			}
+			invalidateOutCV(getVaultPos());
+		}
 
 		if(cvOrder == CVOrder::Pristine) return;
 
 		float activeCVs [CHANNEL_COUNT];
 		int activeCV_count = 0;
-		auto cvs = vault_cv[getVaultPos()];
-		auto gates = vault_gate[getVaultPos()];
 		for(int ci = 0; ci < channels; ci++){
 			if(gates[ci]){
 				activeCVs[activeCV_count] = cvs[ci];
@@ -852,37 +2478,51 @@ struct ChordVault : Module {
 		//Condense the active gates down to the lowest channels
 		for(int ci = 0; ci < channels; ci++){
 			if(ci < activeCV_count){
-				gates[ci] = true;
+				gates[ci] = 1.f;
 				cvs[ci] = activeCVs[ci];		
 			}else{
 				//Set the remaining gates low
-				gates[ci] = false;
+				gates[ci] = 0.f;
 				//Clear any CVs on gates that are low
 				//Not strictly nessecary because those values won't get used
 				//But it just keeps the JSON clean
 				cvs[ci] = 0;
 			}
 		}
+		invalidateOutCV(getVaultPos());
+		outputsDirty = true;
 	}
 
 	void shiftNotes(int semitones){
 		float voct = semitones / 12.f;
-		for(int si = 0; si < VAULT_SIZE; si ++){
+		for(int si = 0; si < vaultSize; si ++){
 			for(int ci = 0; ci < CHANNEL_COUNT; ci++){
 				if(vault_gate[si][ci]){
 					vault_cv[si][ci] += voct;
 				}
 			}
 		}
+		invalidateOutCVs();
 	}
 };
 
 struct ChordVaultWidget : ModuleWidget {
 
+	static std::string getPerfSummary(PerfHistogram& histogram, std::string label){
+		return string::f("%s: mean %.0f, p99 %llu, max %llu", label.c_str(), histogram.getMean(),
+			(unsigned long long)histogram.getPercentile(99.0), (unsigned long long)histogram.getMax());
+	}
+
+	//Unlit segments shown behind the digits, one per digit of the largest step number
+	static std::string getDisplayBgText(int vaultSize){
+		return vaultSize > 99 ? "188" : "18";
+	}
+
 	struct CurStepKnob : LargeKnobWithRange {
 
 		float prev_start_index = -1;
 		float prev_end_index = -1;
+		int prev_vault_size = -1;
 
 		CurStepKnob() {
 			
@@ -895,12 +2535,14 @@ struct ChordVaultWidget : ModuleWidget {
 				auto _module = static_cast<ChordVault*>(this->module);
 				int start_index = _module->seqStart;
 				int end_index = start_index + _module->seqLength - 1;
+				int vault_size = _module->vaultSize;
 
-				if(prev_start_index != start_index || prev_end_index != end_index){
+				if(prev_start_index != start_index || prev_end_index != end_index || prev_vault_size != vault_size){
 					prev_start_index = start_index;
 					prev_end_index = end_index;
-					float min = (float)start_index / VAULT_SIZE_MINUS_1;
-					float max = (float)end_index / VAULT_SIZE_MINUS_1;
+					prev_vault_size = vault_size;
+					float min = (float)start_index / (vault_size - 1);
+					float max = (float)end_index / (vault_size - 1);
 					updateRange(min,max);
 				}
 			}
@@ -922,6 +2564,7 @@ struct ChordVaultWidget : ModuleWidget {
 				if(!module->recording && module->partialPlayClock) steps = -1;
 				else steps = module->getVaultPos();
 
+				setBgText(getDisplayBgText(module->vaultSize));
 				if (steps_prev != steps){
 					steps_prev = steps;
 					if(steps == -1){
@@ -933,8 +2576,9 @@ struct ChordVaultWidget : ModuleWidget {
 					this->fgColor = effStep >= 0 && effStep < module->seqLength ? SCHEME_WHITE : SCHEME_RED_CUSTOM;
 				}
 			}else{
-				text = string::f("1");	
-			}		
+				text = "1";
+			}
+			DigitalDisplay::step();
 		}
 	};
 
@@ -948,14 +2592,16 @@ struct ChordVaultWidget : ModuleWidget {
 		int length_prev = -1;
 		void step() override {
 			if (module) {
+				setBgText(getDisplayBgText(module->vaultSize));
 				int length = module->seqLength;
 				if (length_prev != length){
 					length_prev = length;
 					text = string::f("%d", length);
 				}
 			}else{
-				text = string::f("4");
-			}		
+				text = "4";
+			}
+			DigitalDisplay::step();
 		}
 	};
 
@@ -1002,7 +2648,7 @@ struct ChordVaultWidget : ModuleWidget {
 
 		{
 			CurStepDisplay* display = createWidget<CurStepDisplay>(mm2px(Vec(5.235, 32.974)));
-			display->box.size = mm2px(Vec(5.235, 32.974));
+			display->box.size = mm2px(Vec(5.226, 2.977));
 			display->textPos = mm2px(Vec(5.225+2, 2.976+3).div(2.f)); 
 			display->module = module;
 			addChild(display);
@@ -1017,6 +2663,59 @@ struct ChordVaultWidget : ModuleWidget {
 		}
 	}
 
+	//First few chords of a preset, shown next to its name in the preset browser
+	static std::string getPresetSummary(const PresetInfo& preset){
+		std::string summary;
+		for(size_t i = 0; i < preset.chords.size() && i < 4; i++){
+			summary += (i > 0 ? " " : "") + preset.chords[i];
+		}
+		if(preset.chords.size() > 4) summary += " ...";
+		return summary + string::f("  (%dv)", preset.voices);
+	}
+
+	//Asks for a .scl file, or a .kbm file for the loaded tuning, and hands the new tuning to the module
+	static void loadScalaFile(ChordVault* module, bool keyboardMapping){
+		osdialog_filters* filters = osdialog_filters_parse(keyboardMapping ? "Scala keyboard mapping (.kbm):kbm" : "Scala tuning (.scl):scl");
+		char* pathC = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+		osdialog_filters_free(filters);
+		if(!pathC) return;
+		std::string path = pathC;
+		std::free(pathC);
+
+		std::vector<uint8_t> data = system::readFile(path);
+		std::string text(data.begin(), data.end());
+		std::string error;
+		bool loaded = keyboardMapping ? module->loadTuning(module->sclText, text, error) : module->loadTuning(text, "", error);
+		if(!loaded) osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, (system::getFilename(path) + ": " + error).c_str());
+	}
+
+	static void importMidiFile(ChordVault* module){
+		osdialog_filters* filters = osdialog_filters_parse("MIDI file (.mid):mid,midi");
+		char* pathC = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+		osdialog_filters_free(filters);
+		if(!pathC) return;
+		std::string path = pathC;
+		std::free(pathC);
+
+		MidiChords chords;
+		std::string error;
+		if(!readMidiChords(system::readFile(path), module->vaultSize, chords, error) || !module->stageMidiImport(chords, error)){
+			osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, (system::getFilename(path) + ": " + error).c_str());
+		}
+	}
+
+	static void exportMidiFile(ChordVault* module){
+		osdialog_filters* filters = osdialog_filters_parse("MIDI file (.mid):mid");
+		char* pathC = osdialog_file(OSDIALOG_SAVE, NULL, "ChordVault.mid", filters);
+		osdialog_filters_free(filters);
+		if(!pathC) return;
+		std::string path = pathC;
+		std::free(pathC);
+
+		if(system::getExtension(path) != ".mid") path += ".mid";
+		system::writeFile(path, writeMidiChords(module->getSequenceChords()));
+	}
+
 	void appendContextMenu(Menu* menu) override {
 		ChordVault* module = dynamic_cast<ChordVault*>(this->module);
 
@@ -1026,25 +2725,33 @@ struct ChordVaultWidget : ModuleWidget {
 		menu->addChild(createSubmenuItem("Play Mode", module->recording ? "Record" : "Play",
 			[=](Menu* menu) {
 				menu->addChild(createMenuItem("Record", CHECKMARK(module->recording == true), [module]() { 
-					module->recording = true;
-					module->updateRecordModeLights();
+					module->pushCommand(ChordVault::SET_RECORDING_CMD, true);
 				}));
 				menu->addChild(createMenuItem("Play", CHECKMARK(module->recording == false), [module]() { 
-					module->recording = false;
-					module->updateRecordModeLights();
+					module->pushCommand(ChordVault::SET_RECORDING_CMD, false);
 				}));
 			}
 		));
 
+		menu->addChild(createSubmenuItem("Bank", string::f("%d", module->bank + 1),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("Switches on the next clock, Bank CV on the expander overrides"));
+				for(int i = 0; i < BANK_COUNT; i++){
+					menu->addChild(createMenuItem(string::f("Bank %d", i + 1), CHECKMARK(module->selectedBank == i), [module,i]() { 
+						module->pushCommand(ChordVault::SET_BANK_CMD, i);
+					}));
+				}
+			}
+		));
+
 		menu->addChild(createSubmenuItem("Step Knob Offset Mode", module->startStepMode ? "On" : "Off",
 			[=](Menu* menu) {
 				menu->addChild(createMenuLabel("Step Knob/CV adjusts SEQ start"));
 				menu->addChild(createMenuItem("Off", CHECKMARK(module->startStepMode == false), [module]() { 
-					module->startStepMode = false;
-					module->seqStart = 0; //When leaving the mode reset the sequence offset/start back to 0
+					module->pushCommand(ChordVault::SET_START_STEP_MODE_CMD, false);
 				}));
 				menu->addChild(createMenuItem("On", CHECKMARK(module->startStepMode == true), [module]() { 
-					module->startStepMode = true;
+					module->pushCommand(ChordVault::SET_START_STEP_MODE_CMD, true);
 				}));
 			}
 		));
@@ -1053,10 +2760,150 @@ struct ChordVaultWidget : ModuleWidget {
 			[=](Menu* menu) {
 				for(int i = 0; i < PlayMode_MAX; i++){
 					menu->addChild(createMenuItem(PLAY_MODE_NAMES[i], CHECKMARK(module->playMode == i), [module,i]() { 
-						module->playMode = (PlayMode)i;
-						module->updatePlayModeLights();
+						module->pushCommand(ChordVault::SET_PLAY_MODE_CMD, i);
+					}));
+				}
+			}
+		));
+
+		int weightStep = module->getVaultPos();
+		menu->addChild(createSubmenuItem("Step Weight", string::f("%d", module->banks[module->bank]->weight[weightStep]),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel(string::f("Chance of step %d in Weighted mode", weightStep + 1)));
+				for(int i = 0; i <= STEP_WEIGHT_MAX; i++){
+					menu->addChild(createMenuItem(i == 0 ? "0 (never)" : string::f("%d", i), CHECKMARK(module->banks[module->bank]->weight[weightStep] == i), [module,i,weightStep]() {
+						module->pushCommand(ChordVault::SET_STEP_WEIGHT_CMD, i, weightStep);
 					}));
 				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Reset all weights", "", [module]() {
+					module->pushCommand(ChordVault::RESET_STEP_WEIGHTS_CMD, 0);
+				}));
+			}
+		));
+
+		VaultBank& stepBank = *module->banks[module->bank];
+		std::string gateLengthText = stepBank.gateLength[weightStep] == 0 ? "Clock" : string::f("%d%%", stepBank.gateLength[weightStep]);
+		menu->addChild(createSubmenuItem("Step Gate", string::f("%s x%d %d%%", gateLengthText.c_str(), stepBank.ratchets[weightStep], stepBank.probability[weightStep]),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel(string::f("Gate of step %d", weightStep + 1)));
+				menu->addChild(createSubmenuItem("Gate Length", gateLengthText,
+					[=](Menu* menu) {
+						for(int i = 0; i < GateLength_MAX; i++){
+							int length = GateLength_OPTIONS[i];
+							menu->addChild(createMenuItem(length == 0 ? "Clock" : string::f("%d%%", length), CHECKMARK(module->banks[module->bank]->gateLength[weightStep] == length), [module,weightStep,length]() {
+								module->pushCommand(ChordVault::SET_GATE_LENGTH_CMD, length, weightStep);
+							}));
+						}
+					}
+				));
+				menu->addChild(createSubmenuItem("Ratchets", string::f("%d", stepBank.ratchets[weightStep]),
+					[=](Menu* menu) {
+						for(int i = 1; i <= RATCHETS_MAX; i++){
+							menu->addChild(createMenuItem(string::f("%d", i), CHECKMARK(module->banks[module->bank]->ratchets[weightStep] == i), [module,weightStep,i]() {
+								module->pushCommand(ChordVault::SET_RATCHETS_CMD, i, weightStep);
+							}));
+						}
+					}
+				));
+				menu->addChild(createSubmenuItem("Probability", string::f("%d%%", stepBank.probability[weightStep]),
+					[=](Menu* menu) {
+						for(int i = 0; i < Probability_MAX; i++){
+							int probability = Probability_OPTIONS[i];
+							menu->addChild(createMenuItem(string::f("%d%%", probability), CHECKMARK(module->banks[module->bank]->probability[weightStep] == probability), [module,weightStep,probability]() {
+								module->pushCommand(ChordVault::SET_PROBABILITY_CMD, probability, weightStep);
+							}));
+						}
+					}
+				));
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Reset all steps", "", [module]() {
+					module->pushCommand(ChordVault::RESET_STEP_GATES_CMD, 0);
+				}));
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Markov Transitions", string::f("%d", module->markov[weightStep].count),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel(string::f("From step %d in Markov mode", weightStep + 1)));
+				MarkovRow& row = module->markov[weightStep];
+				for(int ti = 0; ti < row.count; ti++){
+					int target = row.target[ti];
+					menu->addChild(createSubmenuItem(string::f("To step %d", target + 1), string::f("%d%%", (int)std::round(100.f * (row.cumulative[ti] - (ti > 0 ? row.cumulative[ti - 1] : 0.f)))),
+						[=](Menu* menu) {
+							for(int w = 0; w <= STEP_WEIGHT_MAX; w++){
+								menu->addChild(createMenuItem(w == 0 ? "0 (remove)" : string::f("%d", w), CHECKMARK(module->markov[weightStep].getWeight(target) == w), [module,weightStep,target,w]() {
+									module->pushCommand(ChordVault::SET_MARKOV_CMD, w, weightStep, target);
+								}));
+							}
+						}
+					));
+				}
+				if(row.count < MARKOV_TARGETS){
+					menu->addChild(createSubmenuItem("Add transition", "",
+						[=](Menu* menu) {
+							for(int i = 0; i < module->seqLength; i++){
+								int target = (module->seqStart + i) % module->vaultSize;
+								if(module->markov[weightStep].getWeight(target) > 0) continue;
+								menu->addChild(createMenuItem(string::f("To step %d", target + 1), "", [module,weightStep,target]() {
+									module->pushCommand(ChordVault::SET_MARKOV_CMD, 1, weightStep, target);
+								}));
+							}
+						}
+					));
+				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Clear this step", "", [module,weightStep]() {
+					module->pushCommand(ChordVault::CLEAR_MARKOV_STEP_CMD, 0, weightStep);
+				}));
+				menu->addChild(createMenuItem("Clear all steps", "", [module]() {
+					module->pushCommand(ChordVault::CLEAR_MARKOV_CMD, 0);
+				}));
+				menu->addChild(createMenuItem("Learn from recorded steps", "", [module]() {
+					module->pushCommand(ChordVault::LEARN_MARKOV_CMD, 0);
+				}));
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Preset Browser", "",
+			[=](Menu* menu) {
+				std::vector<std::string> directories = {model->getFactoryPresetDirectory(), model->getUserPresetDirectory()};
+				std::vector<PresetInfo> presets = getPresetIndex().refresh(directories);
+				if(presets.empty()){
+					menu->addChild(createMenuLabel("No presets found"));
+					return;
+				}
+
+				//One submenu per detected key, the presets are already sorted by key
+				size_t start = 0;
+				while(start < presets.size()){
+					size_t end = start;
+					while(end < presets.size() && presets[end].key == presets[start].key) end++;
+					std::vector<PresetInfo> group(presets.begin() + start, presets.begin() + end);
+
+					menu->addChild(createSubmenuItem(group[0].key, std::to_string(group.size()),
+						[=](Menu* menu) {
+							for(const PresetInfo& preset : group){
+								std::string path = preset.path;
+								menu->addChild(createMenuItem(preset.name, getPresetSummary(preset), [=]() { 
+									loadAction(path);
+								}));
+							}
+						}
+					));
+					start = end;
+				}
+			}
+		));
+
+		menu->addChild(createSubmenuItem("MIDI File", "",
+			[=](Menu* menu) {
+				menu->addChild(createMenuItem("Import into this bank...", "", [module]() {
+					importMidiFile(module);
+				}));
+				menu->addChild(createMenuItem("Export sequence...", "", [module]() {
+					exportMidiFile(module);
+				}));
 			}
 		));
 
@@ -1066,8 +2913,7 @@ struct ChordVaultWidget : ModuleWidget {
 			[=](Menu* menu) {
 				for(int i = 3; i <= CHANNEL_COUNT; i++){
 					menu->addChild(createMenuItem(std::to_string(i), CHECKMARK(module->channels == i), [module,i]() { 
-						module->channels = i;
-						module->updateActiveChannels();
+						module->pushCommand(ChordVault::SET_CHANNELS_CMD, i);
 					}));
 				}
 			}
@@ -1077,10 +2923,10 @@ struct ChordVaultWidget : ModuleWidget {
 			[=](Menu* menu) {
 				menu->addChild(createMenuLabel("gate output channels match step polyphony"));
 				menu->addChild(createMenuItem("No", CHECKMARK(module->dynamicChannels == false), [module]() { 
-					module->dynamicChannels = false;
+					module->pushCommand(ChordVault::SET_DYNAMIC_CHANNELS_CMD, false);
 				}));
 				menu->addChild(createMenuItem("Yes", CHECKMARK(module->dynamicChannels == true), [module]() { 
-					module->dynamicChannels = true;
+					module->pushCommand(ChordVault::SET_DYNAMIC_CHANNELS_CMD, true);
 				}));
 			}
 		));
@@ -1089,20 +2935,88 @@ struct ChordVaultWidget : ModuleWidget {
 			[=](Menu* menu) {
 				menu->addChild(createMenuLabel("Skip the first partial clock after reset/play"));
 				menu->addChild(createMenuItem("No", CHECKMARK(module->skipPartialClock == false), [module]() { 
-					module->skipPartialClock = false;
+					module->pushCommand(ChordVault::SET_SKIP_PARTIAL_CLOCK_CMD, false);
 				}));
 				menu->addChild(createMenuItem("Yes", CHECKMARK(module->skipPartialClock == true), [module]() { 
-					module->skipPartialClock = true;
+					module->pushCommand(ChordVault::SET_SKIP_PARTIAL_CLOCK_CMD, true);
 				}));
 			}
 		));
 
+		menu->addChild(createSubmenuItem("Strum", StrumMode_LABELS[module->strumMode],
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("Start the voices of each chord one after another"));
+				for(int i = 0; i < StrumMode_MAX; i++){
+					menu->addChild(createMenuItem(StrumMode_LABELS[i], CHECKMARK(module->strumMode == i), [module,i]() {
+						module->pushCommand(ChordVault::SET_STRUM_MODE_CMD, i);
+					}));
+				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createSubmenuItem("Voice Delay", string::f("%d ms", module->strumTime),
+					[=](Menu* menu) {
+						for(int i = 0; i < StrumTime_MAX; i++){
+							int time = StrumTime_OPTIONS[i];
+							menu->addChild(createMenuItem(string::f("%d ms", time), CHECKMARK(module->strumTime == time), [module,time]() {
+								module->pushCommand(ChordVault::SET_STRUM_TIME_CMD, time);
+							}));
+						}
+					}
+				));
+				menu->addChild(createSubmenuItem("Humanize", module->strumJitter == 0 ? "Off" : string::f("%d ms", module->strumJitter),
+					[=](Menu* menu) {
+						menu->addChild(createMenuLabel("Random extra delay per voice"));
+						for(int i = 0; i < StrumJitter_MAX; i++){
+							int jitter = StrumJitter_OPTIONS[i];
+							menu->addChild(createMenuItem(jitter == 0 ? "Off" : string::f("%d ms", jitter), CHECKMARK(module->strumJitter == jitter), [module,jitter]() {
+								module->pushCommand(ChordVault::SET_STRUM_JITTER_CMD, jitter);
+							}));
+						}
+					}
+				));
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Random Seed", string::f("%016llx", (unsigned long long)module->seed),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("Used by Random, Skip, Shuffle and White Keys"));
+				menu->addChild(createMenuItem("Reseed on Reset", CHECKMARK(module->reseedOnReset), [module]() {
+					module->pushCommand(ChordVault::SET_RESEED_ON_RESET_CMD, !module->reseedOnReset);
+				}));
+				menu->addChild(createMenuItem("New Seed", "", [module]() {
+					module->pushCommand(ChordVault::NEW_SEED_CMD, 0);
+				}));
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Vault Size", string::f("%d steps", module->vaultSize),
+			[=](Menu* menu) {
+				for(int i = 0; i < VaultSize_MAX; i++){
+					int size = VaultSize_OPTIONS[i];
+					menu->addChild(createMenuItem(string::f("%d steps", size), CHECKMARK(module->vaultSize == size), [module,size]() { 
+						module->pushCommand(ChordVault::SET_VAULT_SIZE_CMD, size);
+					}));
+				}
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Control Rate", module->controlRate == 1 ? "Every sample" : string::f("%d samples", module->controlRate),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("How often buttons, knobs and length CV are read"));
+				for(int i = 0; i < ControlRate_MAX; i++){
+					int rate = ControlRate_OPTIONS[i];
+					menu->addChild(createMenuItem(rate == 1 ? "Every sample" : string::f("%d samples", rate), CHECKMARK(module->controlRate == rate), [module,rate]() { 
+						module->pushCommand(ChordVault::SET_CONTROL_RATE_CMD, rate);
+					}));
+				}
+			}
+		));
+
 		menu->addChild(createSubmenuItem("Step CV Range", CVRange_LABELS[module->cvRange],
 			[=](Menu* menu) {
 				for(int _i = 0; _i < CVRange_MAX; _i++){
 					int i = CVRange_Order[_i];
 					menu->addChild(createMenuItem(CVRange_LABELS[i], CHECKMARK(module->cvRange == i), [module,i]() { 
-						module->cvRange = (CVRange)i;
+						module->pushCommand(ChordVault::SET_CV_RANGE_CMD, i);
 					}));
 				}
 			}
@@ -1113,7 +3027,85 @@ struct ChordVaultWidget : ModuleWidget {
 				menu->addChild(createMenuLabel("Controls the order in which CV values in a single chord are recorded."));
 				for(int i = 0; i < CVOrder_MAX; i++){
 					menu->addChild(createMenuItem(CVOrder_LABELS[i], CHECKMARK(module->cvOrder == i), [module,i]() { 
-						module->cvOrder = (CVOrder)i;
+						module->pushCommand(ChordVault::SET_CV_ORDER_CMD, i);
+					}));
+				}
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Glide", GlideMode_LABELS[module->glideMode],
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("Glide time is set on the expander"));
+				for(int i = 0; i < GlideMode_MAX; i++){
+					menu->addChild(createMenuItem(GlideMode_LABELS[i], CHECKMARK(module->glideMode == i), [module,i]() {
+						module->pushCommand(ChordVault::SET_GLIDE_MODE_CMD, i);
+					}));
+				}
+			}
+		));
+
+		menu->addChild(createSubmenuItem("Transpose Output", module->transpose == 0 ? "Off" : string::f("%+d", module->transpose),
+			[=](Menu* menu) {
+				menu->addChild(createMenuLabel("Transpose the played notes by semitones"));
+				for(int i = TRANSPOSE_MAX; i >= -TRANSPOSE_MAX; i--){
+					menu->addChild(createMenuItem(i == 0 ? "Off" : string::f("%+d", i), CHECKMARK(module->transpose == i), [module,i]() {
+						module->pushCommand(ChordVault::SET_TRANSPOSE_CMD, i);
+					}));
+				}
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Apply to recorded notes", "", [module]() {
+					module->pushCommand(ChordVault::APPLY_TRANSPOSE_CMD, 0);
+				}));
+			}
+		));
+
+		std::string scaleName = module->scale == Scale_MAX ? module->tuning.name : SCALES[module->scale].name;
+		menu->addChild(createSubmenuItem("Scale Quantizer", module->quantizeRecord || module->quantizeOutput ? ROOT_NOTE_LABELS[module->scaleRoot] + " " + scaleName : "Off",
+			[=](Menu* menu) {
+				menu->addChild(createMenuItem("Quantize recorded notes", CHECKMARK(module->quantizeRecord), [module]() {
+					module->pushCommand(ChordVault::SET_QUANTIZE_RECORD_CMD, !module->quantizeRecord);
+				}));
+				menu->addChild(createMenuItem("Quantize played notes", CHECKMARK(module->quantizeOutput), [module]() {
+					module->pushCommand(ChordVault::SET_QUANTIZE_OUTPUT_CMD, !module->quantizeOutput);
+				}));
+				menu->addChild(createSubmenuItem("Root", ROOT_NOTE_LABELS[module->scaleRoot],
+					[=](Menu* menu) {
+						for(int i = 0; i < 12; i++){
+							menu->addChild(createMenuItem(ROOT_NOTE_LABELS[i], CHECKMARK(module->scaleRoot == i), [module,i]() {
+								module->pushCommand(ChordVault::SET_SCALE_ROOT_CMD, i);
+							}));
+						}
+					}
+				));
+				menu->addChild(createSubmenuItem("Scale", scaleName,
+					[=](Menu* menu) {
+						for(int i = 0; i < Scale_MAX; i++){
+							menu->addChild(createMenuItem(SCALES[i].name, CHECKMARK(module->scale == i), [module,i]() {
+								module->pushCommand(ChordVault::SET_SCALE_CMD, i);
+							}));
+						}
+						if(module->tuning.count > 0){
+							menu->addChild(createMenuItem(std::string("Scala: ") + module->tuning.name, CHECKMARK(module->scale == Scale_MAX), [module]() {
+								module->pushCommand(ChordVault::SET_SCALE_CMD, Scale_MAX);
+							}));
+						}
+					}
+				));
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuItem("Load Scala tuning (.scl)...", "", [module]() {
+					loadScalaFile(module, false);
+				}));
+				if(!module->sclText.empty()){
+					menu->addChild(createMenuItem("Load keyboard mapping (.kbm)...", "", [module]() {
+						loadScalaFile(module, true);
+					}));
+				}
+				if(!module->kbmText.empty()){
+					menu->addChild(createMenuItem("Clear keyboard mapping", "", [module]() {
+						std::string error;
+						if(!module->loadTuning(module->sclText, "", error)){
+							osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, ("Clear keyboard mapping: " + error).c_str());
+						}
 					}));
 				}
 			}
@@ -1123,80 +3115,99 @@ struct ChordVaultWidget : ModuleWidget {
 			[=](Menu* menu) {
 				menu->addChild(createMenuLabel("Transpose all notes by semitones"));
 				menu->addChild(createMenuItem("+12 (Perfect Octave)", "", [module]() { 
-					module->shiftNotes(+12);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +12);
 				}));
 				menu->addChild(createMenuItem("+11 (Major 7th)", "", [module]() { 
-					module->shiftNotes(+11);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +11);
 				}));
 				menu->addChild(createMenuItem("+10 (Minor 7th)", "", [module]() { 
-					module->shiftNotes(+10);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +10);
 				}));
 				menu->addChild(createMenuItem("+9 (Major 6th)", "", [module]() { 
-					module->shiftNotes(+9);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +9);
 				}));
 				menu->addChild(createMenuItem("+8 (Minor 6th)", "", [module]() { 
-					module->shiftNotes(+8);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +8);
 				}));
 				menu->addChild(createMenuItem("+7 (Perfect 5th)", "", [module]() { 
-					module->shiftNotes(+7);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +7);
 				}));
 				menu->addChild(createMenuItem("+6 (Diminished 5th)", "", [module]() { 
-					module->shiftNotes(+6);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +6);
 				}));
 				menu->addChild(createMenuItem("+5 (Perfect 4th)", "", [module]() { 
-					module->shiftNotes(+5);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +5);
 				}));
 				menu->addChild(createMenuItem("+4 (Major 3rd)", "", [module]() { 
-					module->shiftNotes(+4);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +4);
 				}));
 				menu->addChild(createMenuItem("+3 (Minor 3rd)", "", [module]() { 
-					module->shiftNotes(+3);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +3);
 				}));
 				menu->addChild(createMenuItem("+2 (Major 2nd)", "", [module]() { 
-					module->shiftNotes(+2);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +2);
 				}));
 				menu->addChild(createMenuItem("+1 (Minor 2nd)", "", [module]() { 
-					module->shiftNotes(+1);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, +1);
 				}));
 				menu->addChild(createMenuLabel(""));
 				menu->addChild(createMenuItem("-1 (Minor 2nd)", "", [module]() { 
-					module->shiftNotes(-1);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -1);
 				}));
 				menu->addChild(createMenuItem("-2 (Major 2nd)", "", [module]() { 
-					module->shiftNotes(-2);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -2);
 				}));
 				menu->addChild(createMenuItem("-3 (Minor 3rd)", "", [module]() { 
-					module->shiftNotes(-3);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -3);
 				}));
 				menu->addChild(createMenuItem("-4 (Major 3rd)", "", [module]() { 
-					module->shiftNotes(-4);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -4);
 				}));
 				menu->addChild(createMenuItem("-5 (Perfect 4th)", "", [module]() { 
-					module->shiftNotes(-5);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -5);
 				}));
 				menu->addChild(createMenuItem("-6 (Diminished 5th)", "", [module]() { 
-					module->shiftNotes(-6);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -6);
 				}));
 				menu->addChild(createMenuItem("-7 (Perfect 5th)", "", [module]() { 
-					module->shiftNotes(-7);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -7);
 				}));
 				menu->addChild(createMenuItem("-8 (Minor 5th)", "", [module]() { 
-					module->shiftNotes(-8);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -8);
 				}));
 				menu->addChild(createMenuItem("-9 (Major 6th)", "", [module]() { 
-					module->shiftNotes(-9);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -9);
 				}));
 				menu->addChild(createMenuItem("-10 (Minor 7th)", "", [module]() { 
-					module->shiftNotes(-10);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -10);
 				}));
 				menu->addChild(createMenuItem("-11 (Major 7th)", "", [module]() { 
-					module->shiftNotes(-11);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -11);
 				}));
 				menu->addChild(createMenuItem("-12 (Perfect Octave)", "", [module]() { 
-					module->shiftNotes(-12);
+					module->pushCommand(ChordVault::SHIFT_NOTES_CMD, -12);
 				}));
 			}
 		));
+
+		menu->addChild(createSubmenuItem("Performance", module->perfEnabled ? "Measuring" : "",
+			[=](Menu* menu) {
+				menu->addChild(createMenuItem("Measure", CHECKMARK(module->perfEnabled), [module]() {
+					module->pushCommand(ChordVault::SET_PERF_CMD, !module->perfEnabled);
+				}));
+				menu->addChild(createMenuItem("Reset", "", [module]() {
+					module->pushCommand(ChordVault::RESET_PERF_CMD, 0);
+				}));
+				menu->addChild(createMenuItem("Dump to log", "", [module]() {
+					for(int pi = 0; pi < PerfSection_MAX; pi++) INFO("ChordVault %lld %s", (long long)module->id, getPerfSummary(module->perf[pi], PerfSection_LABELS[pi]).c_str());
+				}));
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuLabel(string::f("Per run, in %s", PERF_UNIT)));
+				for(int pi = 0; pi < PerfSection_MAX; pi++){
+					menu->addChild(createMenuLabel(getPerfSummary(module->perf[pi], PerfSection_LABELS[pi])));
+				}
+			}
+		));
 	}
 };
 
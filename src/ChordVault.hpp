@@ -0,0 +1,5 @@
+#pragma once
+
+//Layout of the ChordVault patch data, shared with the preset index that reads saved patches
+#define BANK_COUNT 16
+#define VAULT_DATA_VERSION 1
@@ -0,0 +1,98 @@
+#include "ChordVaultExpander.hpp"
+#include "widgets.hpp"
+
+using namespace aetrion;
+
+ChordVaultExpander::ChordVaultExpander() {
+	config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+	//0-2000ms, exponential so short glides are easy to set
+	configParam(GLIDE_PARAM, 0.f, 1.f, 0.f, "Glide", " ms", 2001.f, 1.f, -1.f);
+	configInput(GLIDE_CV_INPUT, "Glide CV (0-10V)");
+	configInput(BANK_CV_INPUT, "Bank CV (0-10V)");
+	configInput(TRANSPOSE_CV_INPUT, "Transpose CV (1V/oct)");
+	configLight(CONNECTED_LIGHT, "Connected to ChordVault");
+	lightDivider.setDivision(512);
+
+	memset(chainMessages, 0, sizeof chainMessages);
+	memset(expanderMessages, 0, sizeof expanderMessages);
+	leftExpander.producerMessage = &chainMessages[0];
+	leftExpander.consumerMessage = &chainMessages[1];
+	rightExpander.producerMessage = &expanderMessages[0];
+	rightExpander.consumerMessage = &expanderMessages[1];
+	leftLinked = false;
+	rightLinked = false;
+	glideAmount = 0.f;
+	glideTime = 0.f;
+}
+
+void ChordVaultExpander::onExpanderChange(const ExpanderChangeEvent& e) {
+	if(e.side == 0){
+		leftLinked = isChainModule(leftExpander.module);
+		memset(chainMessages, 0, sizeof chainMessages);
+	}else{
+		rightLinked = isChainModule(rightExpander.module);
+		memset(expanderMessages, 0, sizeof expanderMessages);
+	}
+}
+
+void ChordVaultExpander::process(const ProcessArgs& args) {
+	//Pass the chain on, so ChordVaults on both sides of the expander are chained
+	if(rightLinked){
+		*(ChainMessage*)rightExpander.module->leftExpander.producerMessage = *(ChainMessage*)leftExpander.consumerMessage;
+		rightExpander.module->leftExpander.requestMessageFlip();
+	}
+	if(leftLinked){
+		//The exponential curve is only evaluated when the knob or CV moves
+		float glide = clamp(params[GLIDE_PARAM].getValue() + inputs[GLIDE_CV_INPUT].getVoltage() / 10.f, 0.f, 1.f);
+		if(glide != glideAmount){
+			glideAmount = glide;
+			glideTime = getGlideTime(glide);
+		}
+
+		ExpanderMessage* message = (ExpanderMessage*)leftExpander.module->rightExpander.producerMessage;
+		message->chain = ((ExpanderMessage*)rightExpander.consumerMessage)->chain;
+		message->expander = true;
+		message->bankConnected = inputs[BANK_CV_INPUT].isConnected();
+		message->bankCV = inputs[BANK_CV_INPUT].getVoltage();
+		message->transposeCV = inputs[TRANSPOSE_CV_INPUT].getVoltage();
+		message->glideTime = glideTime;
+		leftExpander.module->rightExpander.requestMessageFlip();
+	}
+
+	if(lightDivider.process()){
+		Module* vault = leftExpander.module;
+		lights[CONNECTED_LIGHT].setBrightness(vault && vault->model == modelChordVault ? 1.f : 0.f);
+	}
+}
+
+//Glide time in seconds from the knob plus the CV (0-1), matches the knob display
+float ChordVaultExpander::getGlideTime(float glide) {
+	if(glide == 0.f) return 0.f;
+	return (std::pow(2001.f, glide) - 1.f) / 1000.f;
+}
+
+struct ChordVaultExpanderWidget : ModuleWidget {
+	ChordVaultExpanderWidget(ChordVaultExpander* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/ChordVaultExpander.svg")));
+
+		addChild(createWidget<ScrewSilver>(Vec(0, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 1 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addChild(createLightCentered<SmallLight<BlueLight>>(mm2px(Vec(10.16, 18.721)), module, ChordVaultExpander::CONNECTED_LIGHT));
+
+		addChild(createPanelLabel(mm2px(Vec(10.16, 29.5)), "GLIDE"));
+		addParam(createParamCentered<LargeKnob>(mm2px(Vec(10.16, 40.5)), module, ChordVaultExpander::GLIDE_PARAM));
+		addChild(createPanelLabel(mm2px(Vec(10.16, 54.5)), "CV"));
+		addInput(createInputCentered<aetrion::Port>(mm2px(Vec(10.16, 61.131)), module, ChordVaultExpander::GLIDE_CV_INPUT));
+
+		addChild(createPanelLabel(mm2px(Vec(10.16, 71.5)), "TRANS"));
+		addInput(createInputCentered<aetrion::Port>(mm2px(Vec(10.16, 78.131)), module, ChordVaultExpander::TRANSPOSE_CV_INPUT));
+
+		addChild(createPanelLabel(mm2px(Vec(10.16, 86.5)), "BANK"));
+		addInput(createInputCentered<aetrion::Port>(mm2px(Vec(10.16, 93.131)), module, ChordVaultExpander::BANK_CV_INPUT));
+	}
+};
+
+
+Model* modelChordVaultExpander = createModel<ChordVaultExpander, ChordVaultExpanderWidget>("ChordVaultExpander");
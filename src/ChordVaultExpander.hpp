@@ -0,0 +1,71 @@
+#pragma once
+
+#include "plugin.hpp"
+
+//Sent from left to right through the leftExpander message buffers of the right neighbor. Each ChordVault of a chain reads
+//the one from its left neighbor and sends its own to the right, an expander passes it on unchanged.
+//A message takes one sample per module, so the n-th module after the first ChordVault follows it n samples later.
+struct ChainMessage {
+	int index; //ChordVaults to the left of the receiver, up to CHAIN_MAX
+	bool chained; //False while the first ChordVault records
+	int position; //Position in the combined sequence
+	int offset; //Position in the combined sequence of the receiver's first step
+	bool clockHigh;
+};
+
+//Sent from right to left through the rightExpander message buffers of the left neighbor, an expander passes it on unchanged.
+//Covers the sender and the ChordVaults of the chain after it.
+struct ChainReport {
+	int vaults;
+	int length; //Combined sequence length
+};
+
+//Everything sent from right to left. An expander adds its inputs, which the ChordVault to its left reads one sample later.
+struct ExpanderMessage {
+	ChainReport chain;
+	bool expander; //Sent by a ChordVault Expander, the inputs below are only set then
+	bool bankConnected;
+	float bankCV;
+	float transposeCV;
+	float glideTime; //Seconds
+};
+
+//ChordVaults and their expanders pass the chain messages on to each other
+inline bool isChainModule(Module* module){
+	return module && (module->model == modelChordVault || module->model == modelChordVaultExpander);
+}
+
+//Companion module placed directly to the right of a ChordVault.
+//It only holds the extra inputs and sends them to the ChordVault next to it as expander messages.
+struct ChordVaultExpander : Module {
+	enum ParamId {
+		GLIDE_PARAM,
+		PARAMS_LEN
+	};
+	enum InputId {
+		BANK_CV_INPUT,
+		TRANSPOSE_CV_INPUT,
+		GLIDE_CV_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		CONNECTED_LIGHT,
+		LIGHTS_LEN
+	};
+
+	dsp::ClockDivider lightDivider;
+	ChainMessage chainMessages [2];
+	ExpanderMessage expanderMessages [2];
+	bool leftLinked;
+	bool rightLinked;
+	float glideAmount; //Knob plus CV the glide time was last computed for
+	float glideTime;
+
+	ChordVaultExpander();
+	void onExpanderChange(const ExpanderChangeEvent& e) override;
+	void process(const ProcessArgs& args) override;
+	float getGlideTime(float glide);
+};
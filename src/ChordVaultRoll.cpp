@@ -0,0 +1,159 @@
+#include "ChordVaultRoll.hpp"
+#include "widgets.hpp"
+
+using namespace aetrion;
+
+SnapshotBuffer::SnapshotBuffer() {
+	memset(snapshots, 0, sizeof snapshots);
+	back = 0;
+	middle = 1;
+	front = 2;
+	last = -1;
+}
+
+VaultSnapshot* SnapshotBuffer::getBack() {
+	return &snapshots[back];
+}
+
+const VaultSnapshot* SnapshotBuffer::getLast() {
+	return last >= 0 ? &snapshots[last] : NULL;
+}
+
+void SnapshotBuffer::publish() {
+	last = back;
+	back = middle.exchange(back | FRESH) & ~FRESH;
+}
+
+bool SnapshotBuffer::update() {
+	if(!(middle.load() & FRESH)) return false;
+	front = middle.exchange(front) & ~FRESH;
+	return true;
+}
+
+const VaultSnapshot& SnapshotBuffer::getFront() {
+	return snapshots[front];
+}
+
+ChordVaultRoll::ChordVaultRoll() {
+	config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+	configLight(CONNECTED_LIGHT, "Connected to ChordVault");
+	lightDivider.setDivision(512);
+}
+
+void ChordVaultRoll::process(const ProcessArgs& args) {
+	if(lightDivider.process()){
+		Module* vault = leftExpander.module;
+		if(vault && vault->model == modelChordVaultExpander) vault = vault->leftExpander.module;
+		lights[CONNECTED_LIGHT].setBrightness(vault && vault->model == modelChordVault ? 1.f : 0.f);
+	}
+}
+
+//Piano roll of the front snapshot. It sits in a framebuffer that is only redrawn when a new snapshot arrives.
+struct RollDisplay : Widget {
+	ChordVaultRoll* module;
+	FramebufferWidget* fb;
+	uint32_t version = 0;
+
+	void step() override {
+		if(module && module->snapshots.update() && module->snapshots.getFront().version != version){
+			version = module->snapshots.getFront().version;
+			fb->setDirty();
+		}
+		Widget::step();
+	}
+
+	void draw(const DrawArgs& args) override {
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+		nvgFillColor(args.vg, SCHEME_DARK_BLUE_CUSTOM);
+		nvgFill(args.vg);
+
+		if(!module) return;
+		const VaultSnapshot& snapshot = module->snapshots.getFront();
+		int size = snapshot.vaultSize;
+		if(size <= 0) return;
+		float stepWidth = box.size.x / size;
+		float noteWidth = stepWidth > 2.f ? stepWidth - 1.f : stepWidth;
+
+		//Fit the notes vertically, at least two octaves are shown
+		float low = INFINITY;
+		float high = -INFINITY;
+		for(int si = 0; si < size; si++){
+			for(int ci = 0; ci < snapshot.channels; ci++){
+				if(!(snapshot.gates[si] & (1 << ci))) continue;
+				low = std::min(low, snapshot.cv[si][ci]);
+				high = std::max(high, snapshot.cv[si][ci]);
+			}
+		}
+		if(low > high) low = high = 0.f;
+		float center = (low + high) / 2.f;
+		float range = std::max(high - low, 2.f) + 2.f / 12.f;
+		float bottom = center - range / 2.f;
+		float noteHeight = box.size.y / (range * 12.f);
+
+		//SEQ window, it can wrap around the end of the vault
+		nvgBeginPath(args.vg);
+		int end = snapshot.seqStart + snapshot.seqLength;
+		nvgRect(args.vg, snapshot.seqStart * stepWidth, 0, (std::min(end, size) - snapshot.seqStart) * stepWidth, box.size.y);
+		if(end > size) nvgRect(args.vg, 0, 0, (end - size) * stepWidth, box.size.y);
+		nvgFillColor(args.vg, nvgRGB(0x0f, 0x26, 0x74));//Slightly less dark dark blue
+		nvgFill(args.vg);
+
+		//Notes, one path per color. Steps outside of the SEQ window are dimmed.
+		for(int pass = 0; pass < 2; pass++){
+			bool inWindow = pass == 1;
+			nvgBeginPath(args.vg);
+			for(int si = 0; si < size; si++){
+				if((mod_0_max(si - snapshot.seqStart, size) < snapshot.seqLength) != inWindow) continue;
+				for(int ci = 0; ci < snapshot.channels; ci++){
+					if(!(snapshot.gates[si] & (1 << ci))) continue;
+					float y = box.size.y - (snapshot.cv[si][ci] - bottom) * 12.f * noteHeight - noteHeight / 2.f;
+					nvgRect(args.vg, si * stepWidth, y, noteWidth, noteHeight);
+				}
+			}
+			nvgFillColor(args.vg, inWindow ? SCHEME_WHITE_CUSTOM : nvgRGB(0x4a, 0x5a, 0x8c));
+			nvgFill(args.vg);
+		}
+
+		//Upcoming steps fade out the further ahead they are
+		for(int i = snapshot.upcomingCount - 1; i >= 0; i--){
+			nvgBeginPath(args.vg);
+			nvgRect(args.vg, snapshot.upcoming[i] * stepWidth, 0, noteWidth, box.size.y);
+			nvgFillColor(args.vg, nvgRGBA(0xf6, 0x8f, 0xb2, 0x30 >> i));
+			nvgFill(args.vg);
+		}
+
+		//Playhead
+		if(snapshot.position >= 0 && snapshot.position < size){
+			nvgBeginPath(args.vg);
+			nvgRect(args.vg, snapshot.position * stepWidth, 0, noteWidth, box.size.y);
+			nvgFillColor(args.vg, nvgRGBA(0xf6, 0x8f, 0xb2, 0x60));
+			nvgFill(args.vg);
+		}
+	}
+};
+
+struct ChordVaultRollWidget : ModuleWidget {
+	ChordVaultRollWidget(ChordVaultRoll* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/ChordVaultRoll.svg")));
+
+		addChild(createWidget<ScrewSilver>(Vec(0, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 1 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addChild(createLightCentered<SmallLight<BlueLight>>(mm2px(Vec(40.64, 11.5)), module, ChordVaultRoll::CONNECTED_LIGHT));
+
+		FramebufferWidget* fb = new FramebufferWidget();
+		fb->box.pos = mm2px(Vec(3.0, 18.0));
+		fb->box.size = mm2px(Vec(75.28, 100.0));
+		RollDisplay* display = new RollDisplay();
+		display->box.size = fb->box.size;
+		display->module = module;
+		display->fb = fb;
+		fb->addChild(display);
+		addChild(fb);
+	}
+};
+
+
+Model* modelChordVaultRoll = createModel<ChordVaultRoll, ChordVaultRollWidget>("ChordVaultRoll");
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "plugin.hpp"
+#include <atomic>
+
+#define SNAPSHOT_STEPS_MAX 256
+#define SNAPSHOT_CHANNELS 16
+#define SNAPSHOT_LOOKAHEAD 4
+
+//Everything the piano roll draws, filled by the ChordVault on the engine thread
+struct VaultSnapshot {
+	uint32_t version;
+	int vaultSize;
+	int seqStart;
+	int seqLength;
+	int position; //Playing step, -1 before the first clock
+	int channels;
+	int upcoming [SNAPSHOT_LOOKAHEAD]; //Next steps to play, in order
+	int upcomingCount; //0 when the play mode can't look ahead
+	float cv [SNAPSHOT_STEPS_MAX][SNAPSHOT_CHANNELS]; //Played CVs, with the transpose and quantizer applied
+	uint16_t gates [SNAPSHOT_STEPS_MAX]; //Bit c is set when channel c has a gate
+};
+
+//Triple buffer between the engine thread (writes the back snapshot) and the UI thread (reads the front snapshot).
+//Publishing swaps the back snapshot with the middle one and reading swaps the middle one with the front one,
+//so neither side ever waits for the other or sees a half written snapshot.
+struct SnapshotBuffer {
+	static const int FRESH = 4; //Set on middle when it holds a snapshot the UI thread hasn't taken yet
+
+	VaultSnapshot snapshots [3];
+	std::atomic<int> middle;
+	int back; //Only used by the engine thread
+	int last; //Last published snapshot, -1 before the first. The engine thread never writes it again before the next publish.
+	int front; //Only used by the UI thread
+
+	SnapshotBuffer();
+
+	//Engine thread
+	VaultSnapshot* getBack();
+	const VaultSnapshot* getLast();
+	void publish();
+
+	//UI thread, returns true when a newer snapshot became the front one
+	bool update();
+	const VaultSnapshot& getFront();
+};
+
+//Wide module placed to the right of a ChordVault (or of its expander) that shows all steps as a piano roll
+struct ChordVaultRoll : Module {
+	enum ParamId {
+		PARAMS_LEN
+	};
+	enum InputId {
+		INPUTS_LEN
+	};
+	enum OutputId {
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		CONNECTED_LIGHT,
+		LIGHTS_LEN
+	};
+
+	SnapshotBuffer snapshots;
+	dsp::ClockDivider lightDivider;
+
+	ChordVaultRoll();
+	void process(const ProcessArgs& args) override;
+};
@@ -0,0 +1,217 @@
+#include "midifile.hpp"
+
+#define MIDI_TICKS_PER_BEAT 480
+#define MIDI_TICKS_PER_BAR (4 * MIDI_TICKS_PER_BEAT)
+
+struct MidiNote {
+	uint32_t start;
+	uint32_t end;
+	int pitch;
+};
+
+//Reads through the file in place, nothing is copied
+struct MidiReader {
+	const uint8_t* p;
+	const uint8_t* end;
+
+	bool has(size_t bytes){
+		return (size_t)(end - p) >= bytes;
+	}
+
+	uint32_t readBE(int bytes){
+		uint32_t value = 0;
+		for(int i = 0; i < bytes; i++) value = (value << 8) | *p++;
+		return value;
+	}
+
+	//Variable length quantity, at most 4 bytes
+	bool readVLQ(uint32_t& value){
+		value = 0;
+		for(int i = 0; i < 4; i++){
+			if(!has(1)) return false;
+			uint8_t b = *p++;
+			value = (value << 7) | (b & 0x7f);
+			if(!(b & 0x80)) return true;
+		}
+		return false;
+	}
+};
+
+static bool readTrack(MidiReader track, std::vector<MidiNote>& notes){
+	//Tick each note started on per channel, -1 while the note is off
+	int64_t noteStart [16][128];
+	for(int ch = 0; ch < 16; ch++){
+		for(int n = 0; n < 128; n++) noteStart[ch][n] = -1;
+	}
+
+	uint32_t tick = 0;
+	uint8_t status = 0;
+	while(track.p < track.end){
+		uint32_t delta;
+		if(!track.readVLQ(delta) || !track.has(1)) return false;
+		tick += delta;
+
+		if(*track.p == 0xff){
+			//Meta event
+			uint32_t length;
+			track.p++;
+			if(!track.has(1)) return false;
+			uint8_t type = *track.p++;
+			if(!track.readVLQ(length) || !track.has(length)) return false;
+			track.p += length;
+			if(type == 0x2f) break; //End of track
+			continue;
+		}
+		if(*track.p == 0xf0 || *track.p == 0xf7){
+			//Sysex
+			uint32_t length;
+			track.p++;
+			if(!track.readVLQ(length) || !track.has(length)) return false;
+			track.p += length;
+			continue;
+		}
+		//Channel messages may leave out the status byte to repeat the previous one
+		if(*track.p & 0x80) status = *track.p++;
+
+		int type = status & 0xf0;
+		int ch = status & 0x0f;
+		int dataBytes = type == 0xc0 || type == 0xd0 ? 1 : 2;
+		if(type < 0x80 || type == 0xf0 || !track.has(dataBytes)) return false;
+		int note = track.p[0] & 0x7f;
+		int velocity = dataBytes == 2 ? track.p[1] : 0;
+		track.p += dataBytes;
+
+		bool noteOn = type == 0x90 && velocity > 0;
+		bool noteOff = type == 0x80 || (type == 0x90 && velocity == 0);
+		if((noteOn || noteOff) && noteStart[ch][note] >= 0){
+			//A note on for a note that is still on ends the previous one
+			notes.push_back({(uint32_t)noteStart[ch][note], tick, note});
+			noteStart[ch][note] = -1;
+		}
+		if(noteOn) noteStart[ch][note] = tick;
+	}
+
+	//Notes that are never turned off end with the track
+	for(int ch = 0; ch < 16; ch++){
+		for(int n = 0; n < 128; n++){
+			if(noteStart[ch][n] >= 0) notes.push_back({(uint32_t)noteStart[ch][n], tick, n});
+		}
+	}
+	return true;
+}
+
+bool readMidiChords(const std::vector<uint8_t>& data, int maxChords, MidiChords& chords, std::string& error){
+	MidiReader reader = {data.data(), data.data() + data.size()};
+	if(!reader.has(14) || memcmp(reader.p, "MThd", 4) != 0){
+		error = "Not a standard MIDI file";
+		return false;
+	}
+	reader.p += 4;
+	uint32_t headerLength = reader.readBE(4);
+	if(headerLength < 6 || !reader.has(headerLength)){
+		error = "Not a standard MIDI file";
+		return false;
+	}
+	reader.p += 2; //Format, all formats are read the same way
+	int trackCount = reader.readBE(2);
+	reader.p += headerLength - 4;
+
+	std::vector<MidiNote> notes;
+	notes.reserve(1024);
+	for(int ti = 0; ti < trackCount && reader.has(8); ti++){
+		bool isTrack = memcmp(reader.p, "MTrk", 4) == 0;
+		reader.p += 4;
+		uint32_t length = reader.readBE(4);
+		if(!reader.has(length)){
+			error = "The MIDI file is truncated";
+			return false;
+		}
+		//Unknown chunks are skipped
+		if(isTrack && !readTrack({reader.p, reader.p + length}, notes)){
+			error = string::f("Can't read track %d of the MIDI file", ti + 1);
+			return false;
+		}
+		reader.p += length;
+	}
+
+	std::stable_sort(notes.begin(), notes.end(), [](const MidiNote& a, const MidiNote& b){
+		return a.start < b.start;
+	});
+
+	//Sweep through the notes, a chord lasts as long as any of its notes is held
+	chords.clear();
+	uint32_t chordEnd = 0;
+	for(const MidiNote& note : notes){
+		if(chords.empty() || note.start >= chordEnd){
+			if((int)chords.size() == maxChords) break;
+			chords.push_back(std::vector<int>());
+			chordEnd = note.end;
+		}
+		std::vector<int>& chord = chords.back();
+		if(std::find(chord.begin(), chord.end(), note.pitch) == chord.end()) chord.push_back(note.pitch);
+		chordEnd = std::max(chordEnd, note.end);
+	}
+
+	if(chords.empty()){
+		error = "The MIDI file has no notes";
+		return false;
+	}
+	return true;
+}
+
+static void writeBE(std::vector<uint8_t>& data, uint32_t value, int bytes){
+	for(int i = bytes - 1; i >= 0; i--) data.push_back((value >> (i * 8)) & 0xff);
+}
+
+static void writeVLQ(std::vector<uint8_t>& data, uint32_t value){
+	uint8_t bytes [4];
+	int count = 0;
+	do{
+		bytes[count++] = value & 0x7f;
+		value >>= 7;
+	}while(value && count < 4);
+	for(int i = count - 1; i >= 0; i--) data.push_back(bytes[i] | (i > 0 ? 0x80 : 0));
+}
+
+std::vector<uint8_t> writeMidiChords(const MidiChords& chords){
+	std::vector<uint8_t> track;
+	uint32_t delta = 0;
+	for(const std::vector<int>& chord : chords){
+		if(chord.empty()){
+			delta += MIDI_TICKS_PER_BAR;
+			continue;
+		}
+		for(int note : chord){
+			writeVLQ(track, delta);
+			track.push_back(0x90);
+			track.push_back(clamp(note, 0, 127));
+			track.push_back(100);
+			delta = 0;
+		}
+		delta = MIDI_TICKS_PER_BAR;
+		for(int note : chord){
+			writeVLQ(track, delta);
+			track.push_back(0x80);
+			track.push_back(clamp(note, 0, 127));
+			track.push_back(0);
+			delta = 0;
+		}
+	}
+	//End of track after any trailing rests
+	writeVLQ(track, delta);
+	track.push_back(0xff);
+	track.push_back(0x2f);
+	track.push_back(0x00);
+
+	std::vector<uint8_t> data;
+	data.reserve(22 + track.size());
+	data.insert(data.end(), {'M', 'T', 'h', 'd'});
+	writeBE(data, 6, 4);
+	writeBE(data, 0, 2); //Format 0
+	writeBE(data, 1, 2); //One track
+	writeBE(data, MIDI_TICKS_PER_BEAT, 2);
+	data.insert(data.end(), {'M', 'T', 'r', 'k'});
+	writeBE(data, track.size(), 4);
+	data.insert(data.end(), track.begin(), track.end());
+	return data;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "plugin.hpp"
+
+//MIDI note numbers of each chord, 60 is C4 (0V)
+typedef std::vector<std::vector<int>> MidiChords;
+
+//Reads the chords of a standard MIDI file. Notes that overlap in time form one chord, all tracks and channels are merged.
+//Chords are in time order and the notes of a chord in the order they started. Stops after maxChords chords.
+//Returns false and sets error if the file can't be read.
+bool readMidiChords(const std::vector<uint8_t>& data, int maxChords, MidiChords& chords, std::string& error);
+
+//Writes a format 0 standard MIDI file with one chord per 4/4 bar. Empty chords are written as a bar of rest.
+std::vector<uint8_t> writeMidiChords(const MidiChords& chords);
@@ -0,0 +1,44 @@
+#include "perfstats.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+const char* PERF_UNIT = "cycles";
+#else
+const char* PERF_UNIT = "ns";
+#endif
+
+//First time that doesn't fit into the bucket any more
+static uint64_t bucketEnd(int bucket){
+	if(bucket < 4) return bucket + 1;
+	int octave = bucket / 4 + 1;
+	return (uint64_t)(4 + bucket % 4 + 1) << (octave - 2);
+}
+
+void PerfHistogram::clear(){
+	for(int bi = 0; bi < PERF_BUCKETS; bi++) buckets[bi].store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	total.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+double PerfHistogram::getMean(){
+	uint64_t n = count.load(std::memory_order_relaxed);
+	return n > 0 ? (double)total.load(std::memory_order_relaxed) / n : 0.0;
+}
+
+uint64_t PerfHistogram::getPercentile(double percentile){
+	//Sum the buckets first, count may already include samples that aren't in the buckets yet
+	uint64_t n = 0;
+	for(int bi = 0; bi < PERF_BUCKETS; bi++) n += buckets[bi].load(std::memory_order_relaxed);
+	if(n == 0) return 0;
+	uint64_t rank = (uint64_t)std::ceil(n * percentile / 100.0);
+	uint64_t seen = 0;
+	for(int bi = 0; bi < PERF_BUCKETS; bi++){
+		seen += buckets[bi].load(std::memory_order_relaxed);
+		if(seen >= rank) return bi == PERF_BUCKETS - 1 ? getMax() : bucketEnd(bi);
+	}
+	return getMax();
+}
+
+uint64_t PerfHistogram::getMax(){
+	return max.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "plugin.hpp"
+#include <atomic>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//4 buckets per doubling, the last bucket also holds everything above 16M
+#define PERF_BUCKETS 96
+
+//Timestamp in CPU cycles where there is a cycle counter, otherwise in nanoseconds
+inline uint64_t perfNow(){
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//Unit of perfNow()
+extern const char* PERF_UNIT;
+
+inline int perfBucket(uint64_t time){
+	if(time < 4) return time;
+	int octave = 63 - __builtin_clzll(time);
+	return std::min((octave - 1) * 4 + (int)((time >> (octave - 2)) & 3), PERF_BUCKETS - 1);
+}
+
+//Histogram of the time spent in one section of process().
+//Only the engine thread writes, so plain loads and stores are enough and nothing ever waits.
+//The UI thread can read at any time, a read may be a few samples behind.
+struct PerfHistogram {
+	std::atomic<uint32_t> buckets [PERF_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+
+	PerfHistogram(){
+		clear();
+	}
+
+	void add(uint64_t time){
+		std::atomic<uint32_t>& bucket = buckets[perfBucket(time)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		total.store(total.load(std::memory_order_relaxed) + time, std::memory_order_relaxed);
+		if(time > max.load(std::memory_order_relaxed)) max.store(time, std::memory_order_relaxed);
+	}
+
+	//Engine thread
+	void clear();
+
+	//UI thread
+	double getMean();
+	uint64_t getPercentile(double percentile); //Upper bound of the bucket holding the percentile
+	uint64_t getMax();
+};
+
+//Times consecutive sections, each lap() adds the time since the previous lap (or the start) to a histogram.
+//Does nothing unless enabled, so the cost when off is one branch per section.
+struct PerfLap {
+	bool enabled;
+	uint64_t start;
+	uint64_t last;
+
+	PerfLap(bool enabled) : enabled(enabled) {
+		start = last = enabled ? perfNow() : 0;
+	}
+
+	void lap(PerfHistogram& histogram){
+		if(!enabled) return;
+		uint64_t now = perfNow();
+		histogram.add(now - last);
+		last = now;
+	}
+
+	//Adds the time since the start
+	void finish(PerfHistogram& histogram){
+		if(!enabled) return;
+		histogram.add(perfNow() - start);
+	}
+};
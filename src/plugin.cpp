@@ -9,6 +9,8 @@ void init(Plugin* p) {
 
 	// Add modules here
 	p->addModel(modelChordVault);
+	p->addModel(modelChordVaultExpander);
+	p->addModel(modelChordVaultRoll);
 
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
@@ -0,0 +1,237 @@
+#include "presetindex.hpp"
+#include "ChordVault.hpp"
+#include "util.hpp"
+#include <sys/stat.h>
+
+static const char* NOTE_NAMES [12] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+static const int MAJOR_SCALE [7] = {0, 2, 4, 5, 7, 9, 11};
+
+struct ChordTemplate {
+	const char* suffix;
+	int intervals [4];
+	int count;
+};
+
+//Larger chords first, so a 7th chord wins over the triad it contains
+static const ChordTemplate CHORD_TEMPLATES [] = {
+	{"maj7", {0, 4, 7, 11}, 4},
+	{"7", {0, 4, 7, 10}, 4},
+	{"m7", {0, 3, 7, 10}, 4},
+	{"m7b5", {0, 3, 6, 10}, 4},
+	{"6", {0, 4, 7, 9}, 4},
+	{"m6", {0, 3, 7, 9}, 4},
+	{"", {0, 4, 7}, 3},
+	{"m", {0, 3, 7}, 3},
+	{"dim", {0, 3, 6}, 3},
+	{"aug", {0, 4, 8}, 3},
+	{"sus4", {0, 5, 7}, 3},
+	{"sus2", {0, 2, 7}, 3},
+	{"5", {0, 7}, 2},
+};
+
+static int getPitchClass(float cv){
+	return mod_0_max((int)std::round(cv * 12.f), 12);
+}
+
+std::string getChordName(const std::vector<float>& cvs){
+	if(cvs.empty()) return "-";
+
+	int pitchClasses = 0;
+	float lowest = cvs[0];
+	for(float cv : cvs){
+		pitchClasses |= 1 << getPitchClass(cv);
+		lowest = std::min(lowest, cv);
+	}
+	int bass = getPitchClass(lowest);
+
+	//Try the bass note as root first so inversions are named after it only when nothing else fits
+	for(const ChordTemplate& chord : CHORD_TEMPLATES){
+		for(int i = 0; i < 12; i++){
+			int root = (bass + i) % 12;
+			bool match = true;
+			for(int n = 0; n < chord.count && match; n++){
+				match = pitchClasses & (1 << ((root + chord.intervals[n]) % 12));
+			}
+			if(match){
+				std::string name = std::string(NOTE_NAMES[root]) + chord.suffix;
+				if(root != bass) name += std::string("/") + NOTE_NAMES[bass];
+				return name;
+			}
+		}
+	}
+	return NOTE_NAMES[bass];
+}
+
+//Picks the major scale that covers most of the notes.
+//If the progression starts on the relative minor chord it is reported as minor.
+static std::string detectKey(const std::vector<std::vector<float>>& chords){
+	int histogram [12] = {};
+	for(const std::vector<float>& chord : chords){
+		for(float cv : chord) histogram[getPitchClass(cv)]++;
+	}
+
+	int bestRoot = 0;
+	int bestScore = -1;
+	for(int root = 0; root < 12; root++){
+		int score = 0;
+		for(int degree : MAJOR_SCALE) score += histogram[(root + degree) % 12];
+		//Break ties towards the root note being used
+		score = score * 2 + (histogram[root] > 0 ? 1 : 0);
+		if(score > bestScore){
+			bestScore = score;
+			bestRoot = root;
+		}
+	}
+
+	if(!chords.empty() && !chords[0].empty()){
+		int firstBass = getPitchClass(*std::min_element(chords[0].begin(), chords[0].end()));
+		if(firstBass == (bestRoot + 9) % 12) return std::string(NOTE_NAMES[firstBass]) + " Min";
+	}
+	return std::string(NOTE_NAMES[bestRoot]) + " Maj";
+}
+
+//Reads the active bank from the packed "vaultData" blob written by ChordVault::packVault()
+static void readPackedChords(const std::vector<uint8_t>& data, int bank, std::vector<std::vector<float>>& steps){
+	if(data.size() < 6 || data[0] != VAULT_DATA_VERSION) return;
+	int size = unpack_u16(&data[1]);
+	int channelCount = data[3];
+	uint16_t bankMask = unpack_u16(&data[4]);
+	int gateBytes = (channelCount + 7) / 8;
+	int stepBytes = gateBytes + channelCount * 4;
+	if(!(bankMask & (1 << bank))) return;
+
+	//Skip the banks stored before this one
+	size_t offset = 6;
+	for(int bi = 0; bi < bank; bi++){
+		if(bankMask & (1 << bi)) offset += (size_t)size * stepBytes;
+	}
+	if(offset + (size_t)size * stepBytes > data.size()) return;
+
+	steps.resize(size);
+	for(int si = 0; si < size; si++){
+		const uint8_t* p = &data[offset + si * stepBytes];
+		for(int ci = 0; ci < channelCount; ci++){
+			if((p[ci / 8] >> (ci % 8)) & 1) steps[si].push_back(unpack_f32(p + gateBytes + ci * 4));
+		}
+	}
+}
+
+static void readJsonChords(json_t* vaultJ, std::vector<std::vector<float>>& steps){
+	size_t index;
+	json_t* rowJ;
+	steps.resize(json_array_size(vaultJ));
+	json_array_foreach(vaultJ, index, rowJ){
+		json_t* cvJ = json_object_get(rowJ, "cv");
+		json_t* gateJ = json_object_get(rowJ, "gate");
+		for(size_t ci = 0; ci < json_array_size(gateJ); ci++){
+			if(json_is_true(json_array_get(gateJ, ci))) steps[index].push_back(json_real_value(json_array_get(cvJ, ci)));
+		}
+	}
+}
+
+//Knob value saved by the module, older presets only have the param with the given id
+static int readKnob(json_t* rootJ, json_t* dataJ, const char* key, int paramId){
+	json_t* knobJ = json_object_get(dataJ, key);
+	if(knobJ) return json_integer_value(knobJ);
+	size_t index;
+	json_t* paramJ;
+	json_array_foreach(json_object_get(rootJ, "params"), index, paramJ){
+		if(json_integer_value(json_object_get(paramJ, "id")) == paramId) return (int)json_number_value(json_object_get(paramJ, "value"));
+	}
+	return 0;
+}
+
+static bool readPresetInfo(PresetInfo& info){
+	json_t* rootJ = json_load_file(info.path.c_str(), 0, NULL);
+	if(!rootJ) return false;
+
+	json_t* dataJ = json_object_get(rootJ, "data");
+	if(!dataJ){
+		json_decref(rootJ);
+		return false;
+	}
+
+	//Only the active bank is indexed
+	json_t* bankJ = json_object_get(dataJ, "bank");
+	int bank = clamp(bankJ ? (int)json_integer_value(bankJ) : 0, 0, BANK_COUNT - 1);
+
+	std::vector<std::vector<float>> steps;
+	json_t* vaultDataJ = json_object_get(dataJ, "vaultData");
+	json_t* banksJ = json_object_get(dataJ, "banks");
+	if(vaultDataJ){
+		readPackedChords(string::fromBase64(json_string_value(vaultDataJ)), bank, steps);
+	}else if(banksJ){
+		readJsonChords(json_array_get(banksJ, bank), steps);
+	}else{
+		readJsonChords(json_object_get(dataJ, "vault"), steps);
+	}
+
+	//The sequence length is the LENGTH knob. With Offset mode on the sequence starts at the STEP knob, otherwise at step 0.
+	int size = steps.size();
+	info.steps = clamp(readKnob(rootJ, dataJ, "lengthKnob", 2), 0, size);
+	int seqStart = 0;
+	if(size > 0 && json_is_true(json_object_get(dataJ, "startStepMode"))) seqStart = mod_0_max(readKnob(rootJ, dataJ, "stepKnob", 0), size);
+	std::rotate(steps.begin(), steps.begin() + seqStart, steps.end());
+	steps.resize(info.steps);
+
+	info.voices = json_integer_value(json_object_get(dataJ, "channels"));
+	info.key = detectKey(steps);
+	info.chords.clear();
+	for(const std::vector<float>& chord : steps){
+		info.chords.push_back(getChordName(chord));
+	}
+
+	json_decref(rootJ);
+	return true;
+}
+
+static time_t getModifiedTime(const std::string& path){
+	struct stat fileStat;
+	if(stat(path.c_str(), &fileStat) != 0) return 0;
+	return fileStat.st_mtime;
+}
+
+std::vector<PresetInfo> PresetIndex::refresh(const std::vector<std::string>& directories){
+	std::set<std::string> found;
+	for(const std::string& directory : directories){
+		if(!system::isDirectory(directory)) continue;
+		for(const std::string& path : system::getEntries(directory, -1)){
+			if(system::getExtension(path) != ".vcvm") continue;
+			found.insert(path);
+
+			time_t mtime = getModifiedTime(path);
+			auto it = entries.find(path);
+			if(it != entries.end() && it->second.mtime == mtime) continue;
+
+			PresetInfo info;
+			info.path = path;
+			info.name = system::getStem(path);
+			info.mtime = mtime;
+			info.valid = readPresetInfo(info);
+			entries[path] = info;
+		}
+	}
+
+	//Forget presets that were deleted
+	for(auto it = entries.begin(); it != entries.end();){
+		if(found.count(it->first)) ++it;
+		else it = entries.erase(it);
+	}
+
+	std::vector<PresetInfo> presets;
+	presets.reserve(entries.size());
+	for(auto& entry : entries){
+		if(entry.second.valid) presets.push_back(entry.second);
+	}
+	std::sort(presets.begin(), presets.end(), [](const PresetInfo& a, const PresetInfo& b){
+		if(a.key != b.key) return a.key < b.key;
+		return a.name < b.name;
+	});
+	return presets;
+}
+
+PresetIndex& getPresetIndex(){
+	static PresetIndex index;
+	return index;
+}
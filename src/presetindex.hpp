@@ -0,0 +1,30 @@
+#pragma once
+
+#include "plugin.hpp"
+
+//Summary of one ChordVault preset file
+struct PresetInfo {
+	std::string path;
+	std::string name;
+	time_t mtime = 0;
+	int steps = 0; //Sequence length stored in the preset
+	int voices = 0; //Polyphony channels stored in the preset
+	std::string key; //Detected key, e.g. "C Maj" or "A Min"
+	std::vector<std::string> chords; //Chord name per step, up to `steps`
+	bool valid = false; //False when the file couldn't be read as a ChordVault preset
+};
+
+//Index of the ChordVault preset files.
+//Built once per session and kept in memory. Each file is only parsed again when its modification time changes,
+//files that fail to parse are remembered the same way and left out of the list.
+struct PresetIndex {
+	std::map<std::string, PresetInfo> entries;
+
+	//Scans the directories and returns the presets sorted by key and name
+	std::vector<PresetInfo> refresh(const std::vector<std::string>& directories);
+};
+
+PresetIndex& getPresetIndex();
+
+//Chord name (e.g. "Am7") for a set of V/oct values where 0V is C
+std::string getChordName(const std::vector<float>& cvs);
@@ -0,0 +1,156 @@
+#include "quantizer.hpp"
+#include <sstream>
+
+float PitchTable::quantize(float cv) const {
+	if(count == 0) return cv;
+	const float* end = pitch + count;
+	const float* upper = std::lower_bound(pitch, end, cv);
+	if(upper == end) return end[-1];
+	if(upper == pitch) return pitch[0];
+	const float* lower = upper - 1;
+	return cv - *lower <= *upper - cv ? *lower : *upper;
+}
+
+static int floorDiv(int a, int b){
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+//Lines of a Scala file without comments (lines starting with "!")
+static std::vector<std::string> getScalaLines(const std::string& text){
+	std::vector<std::string> lines;
+	std::istringstream stream(text);
+	std::string line;
+	while(std::getline(stream, line)){
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		if(!line.empty() && line[0] == '!') continue;
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+//A pitch line is either cents (has a ".") or a ratio like "3/2" or "2"
+static bool parsePitch(const std::string& line, double& cents){
+	std::istringstream stream(line);
+	std::string token;
+	if(!(stream >> token)) return false;
+	if(token.find('.') != std::string::npos){
+		cents = atof(token.c_str());
+		return true;
+	}
+	size_t slash = token.find('/');
+	double num = atof(token.substr(0, slash).c_str());
+	double den = slash == std::string::npos ? 1.0 : atof(token.substr(slash + 1).c_str());
+	if(num <= 0.0 || den <= 0.0) return false;
+	cents = 1200.0 * std::log2(num / den);
+	return true;
+}
+
+bool parseScala(const std::string& scl, const std::string& kbm, PitchTable& table, std::string& error){
+	std::vector<std::string> lines = getScalaLines(scl);
+	if(lines.size() < 2){
+		error = "Not a Scala tuning file";
+		return false;
+	}
+	int count = atoi(lines[1].c_str());
+	if(count <= 0 || (int)lines.size() < 2 + count){
+		error = "The tuning has no notes";
+		return false;
+	}
+
+	//Cents of each degree, degree 0 is the unison and degree `count` the period (usually 2/1)
+	std::vector<double> degrees(count + 1, 0.0);
+	for(int di = 1; di <= count; di++){
+		if(!parsePitch(lines[1 + di], degrees[di])){
+			error = string::f("Can't read note %d of the tuning", di);
+			return false;
+		}
+	}
+	double period = degrees[count];
+	if(period <= 0.0){
+		error = "The tuning period must be above the unison";
+		return false;
+	}
+	auto degreeCents = [&](int d) {
+		int octave = floorDiv(d, count);
+		return octave * period + degrees[d - octave * count];
+	};
+
+	//Keyboard mapping, defaults to a linear mapping with degree 0 at 0V
+	int mapSize = 0;
+	int firstNote = 0;
+	int lastNote = 127;
+	int middleNote = 60;
+	int referenceNote = 60;
+	double referenceVolts = 0.0;
+	int octaveDegree = 0;
+	std::vector<int> mapping;
+	if(!kbm.empty()){
+		std::vector<std::string> kbmLines = getScalaLines(kbm);
+		if(kbmLines.size() < 7){
+			error = "Not a Scala keyboard mapping file";
+			return false;
+		}
+		mapSize = atoi(kbmLines[0].c_str());
+		firstNote = clamp(atoi(kbmLines[1].c_str()), 0, 127);
+		lastNote = clamp(atoi(kbmLines[2].c_str()), firstNote, 127);
+		middleNote = atoi(kbmLines[3].c_str());
+		referenceNote = atoi(kbmLines[4].c_str());
+		double referenceFreq = atof(kbmLines[5].c_str());
+		octaveDegree = atoi(kbmLines[6].c_str());
+		if(mapSize < 0 || referenceFreq <= 0.0 || (int)kbmLines.size() < 7 + mapSize){
+			error = "Can't read the keyboard mapping";
+			return false;
+		}
+		referenceVolts = std::log2(referenceFreq / dsp::FREQ_C4);
+		for(int mi = 0; mi < mapSize; mi++){
+			std::string entry = kbmLines[7 + mi];
+			mapping.push_back(entry.find('x') != std::string::npos ? -1 : atoi(entry.c_str()));
+		}
+	}
+	double octaveCents = octaveDegree > 0 ? degreeCents(octaveDegree) : period;
+
+	//Cents of a key relative to the middle note, false for unmapped keys
+	auto keyCents = [&](int key, double& cents) {
+		if(mapSize == 0){
+			cents = degreeCents(key);
+			return true;
+		}
+		int octave = floorDiv(key, mapSize);
+		int degree = mapping[key - octave * mapSize];
+		if(degree < 0) return false;
+		cents = octave * octaveCents + degreeCents(degree);
+		return true;
+	};
+
+	double referenceCents = 0.0;
+	keyCents(referenceNote - middleNote, referenceCents);
+
+	std::vector<float> pitches;
+	if(kbm.empty()){
+		//Without a mapping there are no key limits, cover the whole -10V to 10V range
+		int range = (int)std::ceil(10.0 * 1200.0 / period) * count;
+		for(int key = -range; key <= range; key++){
+			double cents = 0.0;
+			keyCents(key, cents);
+			float volts = referenceVolts + cents / 1200.0;
+			if(volts >= -10.f && volts <= 10.f) pitches.push_back(volts);
+		}
+	}else{
+		for(int note = firstNote; note <= lastNote; note++){
+			double cents = 0.0;
+			if(keyCents(note - middleNote, cents)) pitches.push_back(referenceVolts + (cents - referenceCents) / 1200.0);
+		}
+	}
+	std::sort(pitches.begin(), pitches.end());
+	pitches.erase(std::unique(pitches.begin(), pitches.end()), pitches.end());
+	if(pitches.empty() || pitches.size() > PITCH_TABLE_MAX){
+		error = "The tuning has too many or no notes";
+		return false;
+	}
+
+	snprintf(table.name, sizeof table.name, "%s", lines[0].c_str());
+	table.mapped = !kbm.empty();
+	table.count = pitches.size();
+	std::copy(pitches.begin(), pitches.end(), table.pitch);
+	return true;
+}
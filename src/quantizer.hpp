@@ -0,0 +1,71 @@
+#pragma once
+
+#include "plugin.hpp"
+
+#define PITCH_TABLE_MAX 2048
+
+//Offset in semitones from a pitch class to the nearest note of the scale, searching down first on ties.
+//Only single return statements so it stays a C++11 constexpr function.
+constexpr bool scaleHasNote(int mask, int pc){
+	return (mask >> (((pc % 12) + 12) % 12)) & 1;
+}
+
+constexpr int scaleNearest(int mask, int pc, int d = 0){
+	return d > 6 ? 0 : scaleHasNote(mask, pc - d) ? -d : scaleHasNote(mask, pc + d) ? d : scaleNearest(mask, pc, d + 1);
+}
+
+//12-TET scale, the nearest table is filled in at compile time
+struct Scale {
+	const char* name;
+	int mask; //Bit n set when the note n semitones above the root is in the scale
+	int nearest [12];
+};
+
+#define SCALE(name, mask) {name, mask, { \
+	scaleNearest(mask, 0), scaleNearest(mask, 1), scaleNearest(mask, 2), scaleNearest(mask, 3), \
+	scaleNearest(mask, 4), scaleNearest(mask, 5), scaleNearest(mask, 6), scaleNearest(mask, 7), \
+	scaleNearest(mask, 8), scaleNearest(mask, 9), scaleNearest(mask, 10), scaleNearest(mask, 11)}}
+
+#define Scale_MAX 14
+
+static constexpr Scale SCALES [Scale_MAX] = {
+	SCALE("Chromatic", 0xfff),
+	SCALE("Major", 0xab5),
+	SCALE("Natural Minor", 0x5ad),
+	SCALE("Harmonic Minor", 0x9ad),
+	SCALE("Melodic Minor", 0xaad),
+	SCALE("Dorian", 0x6ad),
+	SCALE("Phrygian", 0x5ab),
+	SCALE("Lydian", 0xad5),
+	SCALE("Mixolydian", 0x6b5),
+	SCALE("Locrian", 0x56b),
+	SCALE("Major Pentatonic", 0x295),
+	SCALE("Minor Pentatonic", 0x4a9),
+	SCALE("Blues", 0x4e9),
+	SCALE("Whole Tone", 0x555),
+};
+
+#undef SCALE
+
+static_assert(SCALES[1].nearest[1] == -1 && SCALES[1].nearest[6] == -1 && SCALES[11].nearest[1] == -1, "Scale tables");
+
+//V/oct (0V = C4) to the nearest note of the scale. Root is in semitones above C.
+inline float quantizeToScale(const Scale& scale, int root, float cv){
+	int note = (int)std::round(cv * 12.f);
+	int pc = ((note - root) % 12 + 12) % 12;
+	return (note + scale.nearest[pc]) / 12.f;
+}
+
+//Every pitch of a Scala tuning in volts, sorted
+struct PitchTable {
+	char name [64];
+	bool mapped; //Pitches are absolute (0V = C4) when a keyboard mapping was loaded, otherwise degree 0 is at 0V
+	int count;
+	float pitch [PITCH_TABLE_MAX];
+
+	float quantize(float cv) const;
+};
+
+//Builds the pitch table from the text of a .scl file and an optional .kbm keyboard mapping (may be empty).
+//Returns false and sets error if the files can't be used.
+bool parseScala(const std::string& scl, const std::string& kbm, PitchTable& table, std::string& error);
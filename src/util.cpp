@@ -31,6 +31,47 @@ void json_boolArray_value(json_t* jArray, bool * array, int length){
 	}
 }
 
+json_t* json_boolArray(float * array, int length){
+	json_t *jArray = json_array();
+	for(int i = 0; i < length; i++){
+		json_array_insert_new(jArray, i, json_bool(array[i] > 0.f));
+	}
+	return jArray;
+}
+void json_boolArray_value(json_t* jArray, float * array, int length){
+	for(int i = 0; i < length; i++){
+		array[i] = json_is_true(json_array_get(jArray, i)) ? 1.f : 0.f;
+	}
+}
+
+void pack_u8(std::vector<uint8_t>& data, uint8_t value){
+	data.push_back(value);
+}
+
+void pack_u16(std::vector<uint8_t>& data, uint16_t value){
+	data.push_back(value & 0xff);
+	data.push_back(value >> 8);
+}
+
+void pack_f32(std::vector<uint8_t>& data, float value){
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof bits);
+	for(int i = 0; i < 4; i++){
+		data.push_back((bits >> (i * 8)) & 0xff);
+	}
+}
+
+uint16_t unpack_u16(const uint8_t* data){
+	return data[0] | (data[1] << 8);
+}
+
+float unpack_f32(const uint8_t* data){
+	uint32_t bits = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+	float value;
+	memcpy(&value, &bits, sizeof value);
+	return value;
+}
+
 float mod_0_max(float val, float max){
 	int whole = std::floor(val/max);
 	return val - whole * max;
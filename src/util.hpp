@@ -12,5 +12,21 @@ void json_floatArray_value(json_t* jArray, float * array, int length);
 json_t* json_boolArray(bool * array, int length);
 void json_boolArray_value(json_t* jArray, bool * array, int length);
 
+//Gate arrays stored as floats (1.f high, 0.f low) are written as json bools
+json_t* json_boolArray(float * array, int length);
+void json_boolArray_value(json_t* jArray, float * array, int length);
+
+//Little-endian packing for binary data
+void pack_u8(std::vector<uint8_t>& data, uint8_t value);
+void pack_u16(std::vector<uint8_t>& data, uint16_t value);
+void pack_f32(std::vector<uint8_t>& data, float value);
+uint16_t unpack_u16(const uint8_t* data);
+float unpack_f32(const uint8_t* data);
+
 float mod_0_max(float val, float max);
-int mod_0_max(int val, int max);
\ No newline at end of file
+int mod_0_max(int val, int max);
+
+//Horizontal max across the four lanes
+inline float hmax(simd::float_4 v){
+	return std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+}
\ No newline at end of file
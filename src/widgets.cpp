@@ -63,6 +63,79 @@ void LargeKnobWithRange::updateRange(float min, float max){
 
 
 
+bool CachedFont::apply(NVGcontext* vg) {
+	if(APP->window->vg != windowVg){
+		std::shared_ptr<Font> font = APP->window->loadFont(path);
+		if (!font)
+			return false;
+		windowVg = APP->window->vg;
+		handle = font->handle;
+	}
+	nvgFontFaceId(vg, handle);
+	return true;
+}
+
+//Draws the unlit segments of its DigitalDisplay, lives inside the display's framebuffer
+struct DigitalDisplayBackground : TransparentWidget {
+	DigitalDisplay* display;
+
+	void draw(const DrawArgs& args) override {
+		if (!display->prepareFont(args))
+			return;
+		nvgFillColor(args.vg, nvgRGB(0x0f, 0x26, 0x74));//Slightly less dark dark blue
+		nvgText(args.vg, display->textPos.x - box.pos.x, display->textPos.y - box.pos.y, display->bgText.c_str(), NULL);
+	}
+};
+
+DigitalDisplay::DigitalDisplay() {
+	fb = new FramebufferWidget();
+	addChild(fb);
+	DigitalDisplayBackground* background = new DigitalDisplayBackground();
+	background->display = this;
+	fb->addChild(background);
+}
+
+void DigitalDisplay::setBgText(const std::string& bgText) {
+	if (bgText == this->bgText)
+		return;
+	this->bgText = bgText;
+	fb->setDirty();
+}
+
+bool DigitalDisplay::prepareFont(const DrawArgs& args) {
+	if (font.path.empty())
+		font.path = fontPath;
+	if (!font.apply(args.vg))
+		return false;
+	nvgFontSize(args.vg, fontSize);
+	nvgTextLetterSpacing(args.vg, 0.0);
+	nvgTextAlign(args.vg, NVG_ALIGN_RIGHT);
+	return true;
+}
+
+void DigitalDisplay::step() {
+	//The size is set after construction, the framebuffer follows it. The framebuffer covers the bounding box
+	//of its child, which gets a margin since the right aligned text can reach past the left edge.
+	if (!fb->box.size.equals(box.size)) {
+		fb->box.size = box.size;
+		for (Widget* child : fb->children) {
+			child->box.pos = Vec(-3 * fontSize, -fontSize);
+			child->box.size = box.size.plus(Vec(4 * fontSize, 2 * fontSize));
+		}
+		fb->setDirty();
+	}
+	Widget::step();
+}
+
+void DigitalDisplay::drawLayer(const DrawArgs& args, int layer) {
+	if (layer == 1 && prepareFont(args)) {
+		// Foreground text
+		nvgFillColor(args.vg, fgColor);
+		nvgText(args.vg, textPos.x, textPos.y, text.c_str(), NULL);
+	}
+	Widget::drawLayer(args, layer);
+}
+
 Port::Port() {
 	setSvg(Svg::load(asset::plugin(pluginInstance,"res/port.svg")));
 	box.size = Vec(26.23, 26.23);
@@ -70,6 +143,25 @@ Port::Port() {
 	shadow->box.pos = Vec(0.0, 1.5);
 }
 
+void PanelLabel::draw(const DrawArgs& args) {
+	if (font.path.empty())
+		font.path = asset::system("res/fonts/Nunito-Bold.ttf");
+	if (!font.apply(args.vg))
+		return;
+	nvgFontSize(args.vg, fontSize);
+	nvgTextLetterSpacing(args.vg, 0.0);
+	nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
+	nvgFillColor(args.vg, color);
+	nvgText(args.vg, 0, 0, text.c_str(), NULL);
+}
+
+PanelLabel* createPanelLabel(Vec pos, std::string text) {
+	PanelLabel* label = new PanelLabel();
+	label->box.pos = pos;
+	label->text = text;
+	return label;
+}
+
 SmallButton::SmallButton() {
 	momentary = true;
 	addFrame(Svg::load(asset::plugin(pluginInstance,"res/small_button_0.svg")));
@@ -13,6 +13,7 @@ namespace aetrion {
 
 static const NVGcolor SCHEME_RED_CUSTOM = nvgRGB(0xf6, 0x8f, 0xb2);
 static const NVGcolor SCHEME_WHITE_CUSTOM = nvgRGB(0xff, 0xff, 0xff);
+static const NVGcolor SCHEME_DARK_BLUE_CUSTOM = nvgRGB(0x06, 0x0e, 0x2c);
 
 //Knobs
 struct LargeKnob : RoundKnob {
@@ -51,6 +52,19 @@ struct RotarySwitch : TBase {
 	}
 };
 
+//Font handle from APP->window->loadFont, which loads into the main window's NanoVG context.
+//Framebuffers draw with a context that shares its fonts, so one handle serves both.
+//The font is only looked up again if the main context is recreated.
+struct CachedFont {
+	std::string path;
+	NVGcontext* windowVg = NULL;
+	int handle = -1;
+
+	bool apply(NVGcontext* vg);
+};
+
+//Seven segment display. The unlit segments (bgText) are drawn into a framebuffer that is only redrawn when
+//they change, the lit digits (text) are drawn on the light layer so they stay bright in a dark room.
 struct DigitalDisplay : Widget {
 	std::string fontPath;
 	std::string bgText;
@@ -60,43 +74,29 @@ struct DigitalDisplay : Widget {
 	NVGcolor fgColor = SCHEME_WHITE;
 	Vec textPos;
 
-	void prepareFont(const DrawArgs& args) {
-		// Get font
-		std::shared_ptr<Font> font = APP->window->loadFont(fontPath);
-		if (!font)
-			return;
-		nvgFontFaceId(args.vg, font->handle);
-		nvgFontSize(args.vg, fontSize);
-		nvgTextLetterSpacing(args.vg, 0.0);
-		nvgTextAlign(args.vg, NVG_ALIGN_RIGHT);
-	}
-
-	void draw(const DrawArgs& args) override {
-		// //Background
-		// nvgBeginPath(args.vg);
-		// nvgRect(args.vg, -1, -1, box.size.x+2, box.size.y+2);
-		// nvgFillColor(args.vg, nvgRGB(0x06, 0x0e, 0x2c)); //Very dark blue
-		// nvgFill(args.vg);
+	FramebufferWidget* fb;
+	CachedFont font;
 
-		prepareFont(args);
+	DigitalDisplay();
+	void setBgText(const std::string& bgText);
+	bool prepareFont(const DrawArgs& args);
+	void step() override;
+	void drawLayer(const DrawArgs& args, int layer) override;
+};
 
-		// Background text
-		nvgFillColor(args.vg, nvgRGB(0x0f, 0x26, 0x74));//Slightly less dark dark blue
-		nvgText(args.vg, textPos.x, textPos.y, bgText.c_str(), NULL);
-	}
+//Text label drawn on top of the panel, centered on its position
+struct PanelLabel : TransparentWidget {
+	std::string text;
+	float fontSize = 9;
+	NVGcolor color = SCHEME_DARK_BLUE_CUSTOM;
 
-	void drawLayer(const DrawArgs& args, int layer) override {
-		if (layer == 1) {
-			prepareFont(args);
+	CachedFont font;
 
-			// Foreground text
-			nvgFillColor(args.vg, fgColor);
-			nvgText(args.vg, textPos.x, textPos.y, text.c_str(), NULL);
-		}
-		Widget::drawLayer(args, layer);
-	}
+	void draw(const DrawArgs& args) override;
 };
 
+PanelLabel* createPanelLabel(Vec pos, std::string text);
+
 struct BlueRedLight : GrayModuleLightWidget {
 	BlueRedLight() {
 		addBaseColor(SCHEME_BLUE);